@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace poser
+{
+
+// Affine transform definition, the upper three rows of a 4x4 transform whose bottom row is always 0, 0, 0, 1, stored
+// row by row with the translation in the last element of each row
+struct AffineTransform
+{
+  glm::vec4 rows[3];
+};
+
+// Drops the bottom row of the matrix, which must be affine
+inline AffineTransform toAffineTransform(const glm::mat4& matrix)
+{
+  const glm::mat4 transposed = glm::transpose(matrix);
+  return { { transposed[0], transposed[1], transposed[2] } };
+}
+
+inline glm::mat4 toMat4(const AffineTransform& transform)
+{
+  return glm::transpose(
+    glm::mat4(transform.rows[0], transform.rows[1], transform.rows[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// Calculates a * b, each row of the result is the rows of b weighted by the elements of the same row of a plus the
+// translation of a
+inline AffineTransform operator*(const AffineTransform& a, const AffineTransform& b)
+{
+  AffineTransform result;
+  for (int row = 0; row < 3; ++row)
+  {
+    const glm::vec4& weights = a.rows[row];
+    result.rows[row] = weights.x * b.rows[0] + weights.y * b.rows[1] + weights.z * b.rows[2] +
+                       glm::vec4(0.0f, 0.0f, 0.0f, weights.w);
+  }
+  return result;
+}
+
+inline glm::vec3 transformPoint(const AffineTransform& transform, const glm::vec3& point)
+{
+  const glm::vec4 homogeneous(point, 1.0f);
+  return glm::vec3(glm::dot(transform.rows[0], homogeneous), glm::dot(transform.rows[1], homogeneous),
+                   glm::dot(transform.rows[2], homogeneous));
+}
+
+inline glm::vec3 transformVector(const AffineTransform& transform, const glm::vec3& vector)
+{
+  return glm::vec3(glm::dot(glm::vec3(transform.rows[0]), vector), glm::dot(glm::vec3(transform.rows[1]), vector),
+                   glm::dot(glm::vec3(transform.rows[2]), vector));
+}
+
+} // namespace poser
@@ -0,0 +1,1439 @@
+#include "Benchmark.h"
+
+#include "Blend.h"
+#include "Cache.h"
+#include "ClipCompression.h"
+#include "Crowd.h"
+#include "FixedTimestep.h"
+#include "Import.h"
+#include "MeshOptimization.h"
+#include "Profiler.h"
+#include "Skinning.h"
+#include "Synthetic.h"
+#include "ThreadPool.h"
+#include "VertexPacking.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace poser
+{
+
+namespace
+{
+
+// Benchmark constants
+constexpr int defaultLoadBenchmarkIterations = 10;
+constexpr int defaultHierarchyBenchmarkBoneCount = 512;
+constexpr int defaultHierarchyBenchmarkDepth = 64;
+constexpr int defaultHierarchyBenchmarkBranchingFactor = 1;
+constexpr int hierarchyBenchmarkIterations = 2000;
+constexpr int defaultImportBenchmarkNodeCount = 5000;
+constexpr int defaultImportBenchmarkBoneCount = 256;
+constexpr int importBenchmarkIterations = 20;
+constexpr double importBenchmarkKeyframeRate = 1.0; // Two keyframes per track over the clip
+constexpr int defaultPoseBenchmarkBoneCount = 256;
+constexpr double poseBenchmarkKeyframeRate = 30.0;
+constexpr int poseBenchmarkFrameCount = 2000;
+constexpr float poseBenchmarkTolerance = 1.0e-4f; // Relative to the magnitude of the reference transforms
+constexpr int defaultCrowdBenchmarkInstanceCount = 1000;
+constexpr int crowdBenchmarkFrameCount = 30;
+constexpr double crowdBenchmarkFrameTime = 1.0 / 60.0; // In seconds
+constexpr int defaultSkinningBenchmarkInstanceCount = 64;
+constexpr int skinningBenchmarkIterations = 10;
+constexpr float skinningBenchmarkTolerance = 1.0e-4f; // Relative to the magnitude of the reference positions
+constexpr int defaultVertexFormatBenchmarkVertexCount = 1000000;
+constexpr int vertexFormatBenchmarkIterations = 10;
+constexpr size_t meshBenchmarkCacheSizes[] = { 16u, 32u }; // Typical post-transform vertex cache sizes
+constexpr int meshBenchmarkIterations = 10;
+constexpr int compressionBenchmarkIterations = 10;
+constexpr int compressionBenchmarkFrameCount = 2000;
+constexpr int defaultClipBenchmarkClipCount = 64;
+constexpr int clipBenchmarkBoneCount = 64;
+constexpr double clipBenchmarkKeyframeRate = 30.0;
+constexpr int clipBenchmarkIterations = 10;
+constexpr char clipBenchmarkFileName[] = "poser_clip_benchmark"; // In the temporary directory, only its cache exists
+constexpr int defaultBlendBenchmarkInstanceCount = 1000;
+constexpr int blendBenchmarkIterations = 20000;
+constexpr float blendBenchmarkCheckWeight = 0.3f;
+constexpr double timestepBenchmarkDisplayRates[] = { 60.0, 144.0, 240.0 }; // In frames per second
+constexpr double timestepBenchmarkSeconds = 5.0;
+constexpr double defaultTimestepBenchmarkSimulationRate = 30.0; // In steps per second
+constexpr int timestepBenchmarkMaxStepCount = 4;
+constexpr int profilerBenchmarkScopeCount = 1000000;
+constexpr char profilerBenchmarkTraceFileName[] = "poser_trace.json"; // In the temporary directory
+
+// Prints the memory used by the decoded keyframes of all clips (including their times) compared to storing each of them
+// as a 4x4 matrix
+void printKeyframeMemory(const ClipLibrary& clips)
+{
+  size_t translationKeyframeCount = 0u, rotationKeyframeCount = 0u, scaleKeyframeCount = 0u;
+  for (size_t i = 0u; i < clips.getClipCount(); ++i)
+  {
+    const Clip& clip = clips.getClip(i);
+    translationKeyframeCount += clip.translationKeyframes.size();
+    rotationKeyframeCount += clip.rotationKeyframes.size();
+    scaleKeyframeCount += clip.scaleKeyframes.size();
+  }
+
+  const size_t keyframeCount = translationKeyframeCount + rotationKeyframeCount + scaleKeyframeCount;
+  const size_t matrixBytes = sizeof(glm::mat4) * keyframeCount;
+  const size_t compactBytes = sizeof(glm::vec3) * translationKeyframeCount + sizeof(glm::quat) * rotationKeyframeCount +
+                              sizeof(glm::vec3) * scaleKeyframeCount + sizeof(float) * keyframeCount;
+
+  std::cout << "Keyframes: " << keyframeCount << " in " << clips.getClipCount() << " clips ("
+            << translationKeyframeCount << " translation, " << rotationKeyframeCount << " rotation, "
+            << scaleKeyframeCount << " scale)\n";
+  std::cout << "Keyframe memory: " << compactBytes / 1024u << " KiB (" << matrixBytes / 1024u
+            << " KiB as 4x4 matrices, " << static_cast<double>(matrixBytes) / static_cast<double>(compactBytes)
+            << "x smaller)\n";
+}
+
+// Compares importing the model through Assimp (cold) against loading it from the cache (warm)
+bool benchmarkLoad(const char* fileName, int iterations)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+
+  double coldMilliseconds = 0.0;
+  for (int i = 0; i < iterations; ++i)
+  {
+    const Clock::time_point start = Clock::now();
+    if (!importModel(fileName, model))
+    {
+      return false;
+    }
+    coldMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  if (!saveCache(fileName, model))
+  {
+    return false;
+  }
+
+  double warmMilliseconds = 0.0;
+  for (int i = 0; i < iterations; ++i)
+  {
+    const Clock::time_point start = Clock::now();
+    if (!loadCache(fileName, model))
+    {
+      std::cerr << "Failed to load model cache";
+      return false;
+    }
+    warmMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  // The cache is copied out of the mapping into the model, reading the mapping in place is what that copy adds to
+  double readMilliseconds = 0.0;
+  size_t cacheSize = 0u;
+  for (int i = 0; i < iterations; ++i)
+  {
+    const Clock::time_point start = Clock::now();
+    cacheSize = readCache(fileName);
+    readMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  coldMilliseconds /= iterations;
+  warmMilliseconds /= iterations;
+  readMilliseconds /= iterations;
+  std::cout << "Model: " << fileName << " (" << model.mesh.vertices.size() << " vertices, "
+            << model.mesh.indices.size() << " indices, " << model.skeleton.bones.size() << " bones)\n";
+  printKeyframeMemory(model.clips);
+  std::cout << "Cold load (Assimp import): " << coldMilliseconds << " ms\n";
+  std::cout << "Warm load (mapped cache):  " << warmMilliseconds << " ms\n";
+  std::cout << "Reading the mapped cache in place: " << readMilliseconds << " ms (" << cacheSize / 1024u
+            << " KiB), validating and copying it adds " << warmMilliseconds - readMilliseconds << " ms\n";
+  std::cout << "Speedup: " << coldMilliseconds / warmMilliseconds << "x over " << iterations << " iterations\n";
+  return true;
+}
+
+// Compares walking the parent chain of each bone to the root (the previous approach) against a single forward pass
+// over bones sorted parent before child, and the forward pass over 4x4 matrices against affine 3x4 transforms
+void benchmarkHierarchy(int boneCount, int depth, int branchingFactor)
+{
+  using Clock = std::chrono::steady_clock;
+
+  const std::vector<int> parents = makeSyntheticHierarchy(boneCount, depth, branchingFactor);
+
+  // Generate deterministic local transforms
+  std::vector<glm::mat4> localTransforms(parents.size());
+  for (size_t i = 0u; i < localTransforms.size(); ++i)
+  {
+    const float angle = 0.01f * static_cast<float>(i % 97u);
+    localTransforms.at(i) = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f)) *
+                            glm::toMat4(glm::angleAxis(angle, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f))));
+  }
+
+  std::vector<glm::mat4> walkTransforms(parents.size()), linearTransforms(parents.size());
+  std::vector<AffineTransform> localAffineTransforms(parents.size()), affineTransforms(parents.size());
+  std::transform(localTransforms.begin(), localTransforms.end(), localAffineTransforms.begin(),
+                 [](const glm::mat4& transform) { return toAffineTransform(transform); });
+
+  // Parent walk
+  const Clock::time_point walkStart = Clock::now();
+  for (int iteration = 0; iteration < hierarchyBenchmarkIterations; ++iteration)
+  {
+    for (size_t i = 0u; i < parents.size(); ++i)
+    {
+      glm::mat4 transform = localTransforms[i];
+      for (int parent = parents[i]; parent >= 0; parent = parents[parent])
+      {
+        transform = localTransforms[parent] * transform;
+      }
+      walkTransforms[i] = transform;
+    }
+  }
+  const double walkSeconds = std::chrono::duration<double>(Clock::now() - walkStart).count();
+
+  // Forward pass
+  const Clock::time_point linearStart = Clock::now();
+  for (int iteration = 0; iteration < hierarchyBenchmarkIterations; ++iteration)
+  {
+    for (size_t i = 0u; i < parents.size(); ++i)
+    {
+      const int parent = parents[i];
+      linearTransforms[i] = parent >= 0 ? linearTransforms[parent] * localTransforms[i] : localTransforms[i];
+    }
+  }
+  const double linearSeconds = std::chrono::duration<double>(Clock::now() - linearStart).count();
+
+  // Forward pass over affine transforms
+  const Clock::time_point affineStart = Clock::now();
+  for (int iteration = 0; iteration < hierarchyBenchmarkIterations; ++iteration)
+  {
+    for (size_t i = 0u; i < parents.size(); ++i)
+    {
+      const int parent = parents[i];
+      affineTransforms[i] =
+        parent >= 0 ? affineTransforms[parent] * localAffineTransforms[i] : localAffineTransforms[i];
+    }
+  }
+  const double affineSeconds = std::chrono::duration<double>(Clock::now() - affineStart).count();
+
+  // Both approaches multiply in a different order, so only expect them to match within floating point precision
+  float maxError = 0.0f, maxAffineError = 0.0f;
+  for (size_t i = 0u; i < parents.size(); ++i)
+  {
+    const glm::mat4 affineTransform = toMat4(affineTransforms[i]);
+    for (int column = 0; column < 4; ++column)
+    {
+      const glm::vec4 difference = glm::abs(walkTransforms[i][column] - linearTransforms[i][column]);
+      maxError = std::max(maxError, glm::compMax(difference));
+      const glm::vec4 affineDifference = glm::abs(affineTransform[column] - linearTransforms[i][column]);
+      maxAffineError = std::max(maxAffineError, glm::compMax(affineDifference));
+    }
+  }
+
+  const double bonesEvaluated = static_cast<double>(boneCount) * hierarchyBenchmarkIterations;
+  std::cout << "Skeleton: " << boneCount << " bones, depth " << depth + 1 << ", branching factor " << branchingFactor
+            << "\n";
+  std::cout << "Parent walk:  " << bonesEvaluated / walkSeconds / 1.0e6 << " million bones/s\n";
+  std::cout << "Forward pass: " << bonesEvaluated / linearSeconds / 1.0e6 << " million bones/s\n";
+  std::cout << "Speedup: " << walkSeconds / linearSeconds << "x, max error " << maxError << "\n";
+  std::cout << "Forward pass (affine 3x4): " << bonesEvaluated / affineSeconds / 1.0e6 << " million bones/s\n";
+  std::cout << "Speedup over 4x4: " << linearSeconds / affineSeconds << "x, max error " << maxAffineError << "\n";
+}
+
+// Compares looking up bones by name through a linear scan (the previous approach) against the bone index map, and
+// measures the time to import a scene with many nodes
+void benchmarkImport(int nodeCount, int boneCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  SyntheticRig rig;
+  rig.boneCount = boneCount;
+  rig.depth = defaultHierarchyBenchmarkDepth;
+  rig.helperCount = nodeCount - boneCount - 1;
+  rig.vertexCount = boneCount * 3;
+  rig.keyframeRate = importBenchmarkKeyframeRate;
+  const std::unique_ptr<aiScene> scene = makeSyntheticScene(rig);
+  const aiMesh* mesh = scene->mMeshes[0];
+
+  // Gather every name that the import looks up, one per node and one per animation channel
+  std::vector<const aiString*> names;
+  {
+    std::vector<const aiNode*> stack = { scene->mRootNode };
+    while (!stack.empty())
+    {
+      const aiNode* node = stack.back();
+      stack.pop_back();
+      names.push_back(&node->mName);
+      stack.insert(stack.end(), node->mChildren, node->mChildren + node->mNumChildren);
+    }
+
+    const aiAnimation* animation = scene->mAnimations[0];
+    for (unsigned int i = 0u; i < animation->mNumChannels; ++i)
+    {
+      names.push_back(&animation->mChannels[i]->mNodeName);
+    }
+  }
+
+  // Linear scan
+  int linearChecksum = 0;
+  const Clock::time_point linearStart = Clock::now();
+  for (int iteration = 0; iteration < importBenchmarkIterations; ++iteration)
+  {
+    for (const aiString* name : names)
+    {
+      int boneIndex = -1;
+      for (unsigned int i = 0u; i < mesh->mNumBones; ++i)
+      {
+        if (mesh->mBones[i]->mName == *name)
+        {
+          boneIndex = static_cast<int>(i);
+          break;
+        }
+      }
+      linearChecksum += boneIndex;
+    }
+  }
+  const double linearSeconds = std::chrono::duration<double>(Clock::now() - linearStart).count();
+
+  // Bone index map, including the time to build it
+  int hashedChecksum = 0;
+  const Clock::time_point hashedStart = Clock::now();
+  for (int iteration = 0; iteration < importBenchmarkIterations; ++iteration)
+  {
+    const BoneIndexMap boneIndices = buildBoneIndexMap(scene.get());
+    for (const aiString* name : names)
+    {
+      hashedChecksum += findNamedBone(boneIndices, *name);
+    }
+  }
+  const double hashedSeconds = std::chrono::duration<double>(Clock::now() - hashedStart).count();
+
+  // Full import
+  Model model;
+  const Clock::time_point importStart = Clock::now();
+  for (int iteration = 0; iteration < importBenchmarkIterations; ++iteration)
+  {
+    importScene(scene.get(), model);
+  }
+  const double importSeconds = std::chrono::duration<double>(Clock::now() - importStart).count();
+
+  std::cout << "Scene: " << names.size() - mesh->mNumBones << " nodes, " << mesh->mNumBones << " bones\n";
+  std::cout << "Bone lookups (linear scan): " << linearSeconds * 1.0e3 / importBenchmarkIterations << " ms\n";
+  std::cout << "Bone lookups (index map):   " << hashedSeconds * 1.0e3 / importBenchmarkIterations << " ms\n";
+  std::cout << "Speedup: " << linearSeconds / hashedSeconds << "x"
+            << (linearChecksum == hashedChecksum ? "" : ", lookups DO NOT MATCH") << "\n";
+  std::cout << "Import: " << importSeconds * 1.0e3 / importBenchmarkIterations << " ms\n";
+}
+
+// Returns the offset of the keyframe of the track before the time and the factor towards the next one with a linear
+// search, holding the first and last keyframes outside of the track
+std::pair<uint32_t, float> findKeyframeReference(const std::vector<float>& times, const Track& track, float time)
+{
+  uint32_t index = 0u;
+  while (index + 1u < track.count && times.at(track.first + index + 1u) <= time)
+  {
+    ++index;
+  }
+
+  const uint32_t offset = track.first + index;
+  if (index + 1u >= track.count || time <= times.at(offset))
+  {
+    return { offset, 0.0f };
+  }
+  return { offset, (time - times.at(offset)) / (times.at(offset + 1u) - times.at(offset)) };
+}
+
+// Poses the skeleton at the time in seconds one bone at a time with glm, lerp for translation and scale, normalized
+// lerp along the shorter arc for rotation and translation * rotation * scale matrices, independently of the kernels
+void updatePoseReference(const Skeleton& skeleton,
+                         const Clip& clip,
+                         double time,
+                         std::vector<AffineTransform>& boneTransforms)
+{
+  const float clipTime = clip.duration > 0.0f ? static_cast<float>(std::fmod(time, clip.duration)) : 0.0f;
+  const auto sampleVectors = [clipTime](const std::vector<glm::vec3>& keyframes, const std::vector<float>& times,
+                                        const Track& track)
+  {
+    const auto [offset, factor] = findKeyframeReference(times, track, clipTime);
+    return factor > 0.0f ? glm::mix(keyframes.at(offset), keyframes.at(offset + 1u), factor) : keyframes.at(offset);
+  };
+
+  std::vector<glm::mat4> posedTransforms(skeleton.bones.size());
+  boneTransforms.resize(skeleton.bones.size());
+  for (size_t i = 0u; i < skeleton.bones.size(); ++i)
+  {
+    const glm::vec3 translation = sampleVectors(clip.translationKeyframes, clip.translationTimes,
+                                                clip.translationTracks.at(i));
+    const glm::vec3 scale = sampleVectors(clip.scaleKeyframes, clip.scaleTimes, clip.scaleTracks.at(i));
+
+    const auto [offset, factor] = findKeyframeReference(clip.rotationTimes, clip.rotationTracks.at(i), clipTime);
+    glm::quat rotation = clip.rotationKeyframes.at(offset);
+    if (factor > 0.0f)
+    {
+      const glm::quat& a = clip.rotationKeyframes.at(offset);
+      glm::quat b = clip.rotationKeyframes.at(offset + 1u);
+      if (glm::dot(a, b) < 0.0f)
+      {
+        b = -b;
+      }
+      rotation = glm::normalize(glm::quat(glm::mix(a.w, b.w, factor), glm::mix(a.x, b.x, factor),
+                                          glm::mix(a.y, b.y, factor), glm::mix(a.z, b.z, factor)));
+    }
+
+    glm::mat4 transform = glm::mat4_cast(rotation);
+    transform[0] *= scale.x;
+    transform[1] *= scale.y;
+    transform[2] *= scale.z;
+    transform[3] = glm::vec4(translation, 1.0f);
+
+    const Bone& bone = skeleton.bones.at(i);
+    posedTransforms.at(i) = bone.parent >= 0 ? posedTransforms.at(bone.parent) * transform : transform;
+    boneTransforms.at(i) = toAffineTransform(posedTransforms.at(i)) * bone.inverseBindMatrix;
+  }
+}
+
+// Compares the scalar pose kernels against the SIMD kernels available in this build on a synthetic skeleton and
+// verifies that each of them matches the per-bone glm reference, returns false if one does not
+bool benchmarkPose(int boneCount, int depth)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  {
+    SyntheticRig rig;
+    rig.boneCount = boneCount;
+    rig.depth = depth;
+    rig.keyframeRate = poseBenchmarkKeyframeRate;
+    const std::unique_ptr<aiScene> scene = makeSyntheticScene(rig);
+    importScene(scene.get(), model);
+  }
+
+  Pose initialPose;
+  initialPose.resize(model.skeleton.bones.size());
+  double scalarSeconds = 0.0;
+  bool matches = true;
+
+  // Every kernel ends on the pose of the last frame
+  const double lastFrameTime = (poseBenchmarkFrameCount - 1) / 60.0;
+  std::vector<AffineTransform> referenceBoneTransforms;
+  updatePoseReference(model.skeleton, model.clips.getClip(0u), lastFrameTime, referenceBoneTransforms);
+
+  std::cout << "Skeleton: " << boneCount << " bones, depth " << depth + 1 << ", " << poseBenchmarkKeyframeRate
+            << " keyframes per second\n";
+
+  // Play back the clip a few times over at 60 frames per second with each kernel, the scalar kernel comes first
+  for (const Kernel kernel : getKernels())
+  {
+    Pose pose = initialPose;
+    const Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < poseBenchmarkFrameCount; ++frame)
+    {
+      updatePose(model.skeleton, model.clips.getClip(0u), frame / 60.0, pose, kernel);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (kernel == Kernel::Scalar)
+    {
+      scalarSeconds = seconds;
+    }
+
+    // The scalar kernels share their code with the SIMD kernels, so they are checked against the reference as well
+    float maxError = 0.0f;
+    for (size_t i = 0u; i < model.skeleton.bones.size(); ++i)
+    {
+      for (int row = 0; row < 3; ++row)
+      {
+        const glm::vec4& expected = referenceBoneTransforms.at(i).rows[row];
+        const glm::vec4 difference = glm::abs(pose.boneTransforms.at(i).rows[row] - expected);
+        maxError = std::max(maxError, glm::compMax(difference / glm::max(glm::abs(expected), 1.0f)));
+      }
+    }
+
+    const bool kernelMatches = maxError <= poseBenchmarkTolerance;
+    matches &= kernelMatches;
+    const double bonesEvaluated = static_cast<double>(boneCount) * poseBenchmarkFrameCount;
+    std::cout << getKernelName(kernel) << " kernels: " << bonesEvaluated / seconds / 1.0e6 << " million bones/s ("
+              << scalarSeconds / seconds << "x), max error " << maxError
+              << (kernelMatches ? "" : ", DOES NOT MATCH the per-bone glm reference") << "\n";
+  }
+  return matches;
+}
+
+// Measures the throughput of posing a crowd as the thread count scales up and verifies that every thread count poses
+// the instances exactly like a single thread without the thread pool does
+bool benchmarkCrowd(const char* fileName, int instanceCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  bool loadedFromCache;
+  if (!loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
+
+  std::vector<Instance> instances = createInstances(model, instanceCount);
+
+  // Reference poses
+  std::vector<std::vector<AffineTransform>> referenceBoneTransforms(instances.size());
+  for (size_t i = 0u; i < instances.size(); ++i)
+  {
+    for (int frame = 0; frame < crowdBenchmarkFrameCount; ++frame)
+    {
+      updateAnimation(model, instances.at(i), frame * crowdBenchmarkFrameTime, SkinningMode::LinearBlend);
+    }
+    referenceBoneTransforms.at(i) = instances.at(i).pose.boneTransforms;
+  }
+
+  std::cout << "Model: " << fileName << " (" << model.skeleton.bones.size() << " bones), " << instanceCount
+            << " instances\n";
+
+  const unsigned int maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  double singleThreadRate = 0.0;
+  bool identical = true;
+  for (unsigned int threadCount = 1u; threadCount <= maxThreadCount; ++threadCount)
+  {
+    ThreadPool threadPool(threadCount);
+    instances = createInstances(model, instanceCount); // Reset the cursors
+
+    const Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < crowdBenchmarkFrameCount; ++frame)
+    {
+      updateAnimations(threadPool, model, instances, frame * crowdBenchmarkFrameTime, SkinningMode::LinearBlend);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    bool matches = true;
+    for (size_t i = 0u; i < instances.size(); ++i)
+    {
+      const std::vector<AffineTransform>& boneTransforms = instances.at(i).pose.boneTransforms;
+      matches &= (std::memcmp(boneTransforms.data(), referenceBoneTransforms.at(i).data(),
+                              sizeof(AffineTransform) * boneTransforms.size()) == 0);
+    }
+    identical &= matches;
+
+    const double rate = static_cast<double>(instanceCount) * crowdBenchmarkFrameCount / seconds;
+    if (threadCount == 1u)
+    {
+      singleThreadRate = rate;
+    }
+
+    std::cout << threadCount << " threads: " << rate << " instances/s (" << rate / singleThreadRate << "x), "
+              << (matches ? "identical to" : "DIFFERENT FROM") << " single-threaded reference\n";
+  }
+
+  return identical;
+}
+
+// Skins the vertices with the bone transforms of each instance, either affine transforms or dual quaternions, with the
+// reference implementation, with each kernel and with the widest kernels across the threads of a thread pool, all
+// specialized for the influence count of each influence range, and once more with the widest kernels specialized for
+// the largest influence count of all vertices, measures their throughput and verifies that they all match the reference
+template<typename BoneTransform>
+bool benchmarkSkinning(SkinningMode skinningMode,
+                       const std::vector<Vertex>& vertices,
+                       const std::vector<InfluenceRange>& influenceRanges,
+                       const std::vector<std::vector<BoneTransform>>& instanceBoneTransforms)
+{
+  using Clock = std::chrono::steady_clock;
+
+  const double skinnedVertexCount = static_cast<double>(vertices.size()) *
+                                    static_cast<double>(instanceBoneTransforms.size()) * skinningBenchmarkIterations;
+
+  // Skins each instance into its own skinned vertices with the function a few times over and returns the seconds taken
+  const auto measure = [&](const auto& skin, std::vector<std::vector<SkinnedVertex>>& skinnedVertices)
+  {
+    skinnedVertices.assign(instanceBoneTransforms.size(), std::vector<SkinnedVertex>(vertices.size()));
+    const Clock::time_point start = Clock::now();
+    for (int iteration = 0; iteration < skinningBenchmarkIterations; ++iteration)
+    {
+      for (size_t i = 0u; i < instanceBoneTransforms.size(); ++i)
+      {
+        skin(instanceBoneTransforms.at(i), skinnedVertices.at(i));
+      }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  std::vector<std::vector<SkinnedVertex>> referenceSkinnedVertices;
+  const double referenceSeconds = measure(
+    [&vertices](const std::vector<BoneTransform>& boneTransforms, std::vector<SkinnedVertex>& skinnedVertices)
+    { skinVerticesReference(vertices, boneTransforms, 0u, vertices.size(), skinnedVertices); },
+    referenceSkinnedVertices);
+  std::cout << getSkinningModeName(skinningMode) << " reference: " << skinnedVertexCount / referenceSeconds / 1.0e6
+            << " million vertices/s\n";
+
+  // Compares the skinned vertices against the reference relative to the magnitude of the reference, returns true if
+  // they are within the tolerance
+  const auto verify =
+    [&](const char* name, double seconds, const std::vector<std::vector<SkinnedVertex>>& skinnedVertices)
+  {
+    float maxError = 0.0f;
+    for (size_t i = 0u; i < skinnedVertices.size(); ++i)
+    {
+      for (size_t j = 0u; j < vertices.size(); ++j)
+      {
+        const SkinnedVertex& a = skinnedVertices.at(i).at(j);
+        const SkinnedVertex& b = referenceSkinnedVertices.at(i).at(j);
+        const glm::vec3 positionError = glm::abs(a.position - b.position) / glm::max(glm::abs(b.position), 1.0f);
+        const glm::vec3 normalError = glm::abs(a.normal - b.normal);
+        maxError = std::max({ maxError, glm::compMax(positionError), glm::compMax(normalError) });
+      }
+    }
+
+    const bool matches = maxError <= skinningBenchmarkTolerance;
+    std::cout << getSkinningModeName(skinningMode) << ", " << name << ": " << skinnedVertexCount / seconds / 1.0e6
+              << " million vertices/s (" << referenceSeconds / seconds << "x), max error " << maxError
+              << (matches ? "" : ", DOES NOT MATCH the reference") << "\n";
+    return matches;
+  };
+
+  bool matches = true;
+  for (const Kernel kernel : getKernels())
+  {
+    std::vector<std::vector<SkinnedVertex>> skinnedVertices;
+    const double seconds = measure(
+      [&vertices, &influenceRanges, kernel](const std::vector<BoneTransform>& boneTransforms,
+                                            std::vector<SkinnedVertex>& skinnedVertices)
+      {
+        for (const InfluenceRange& range : influenceRanges)
+        {
+          skinVertices(vertices, boneTransforms, range.firstVertex, range.firstVertex + range.vertexCount,
+                       range.influenceCount, skinnedVertices, kernel);
+        }
+      },
+      skinnedVertices);
+    matches &= verify((std::string(getKernelName(kernel)) + " kernels").c_str(), seconds, skinnedVertices);
+  }
+
+  // Without the influence ranges every vertex pays for the largest influence count, like rigid vertices next to a few
+  // blended ones do when they share the kernels
+  {
+    const Kernel kernel = getKernels().back();
+    const int influenceCount = getInfluenceCount(vertices);
+    std::vector<std::vector<SkinnedVertex>> skinnedVertices;
+    const double seconds = measure(
+      [&vertices, influenceCount, kernel](const std::vector<BoneTransform>& boneTransforms,
+                                          std::vector<SkinnedVertex>& skinnedVertices)
+      { skinVertices(vertices, boneTransforms, 0u, vertices.size(), influenceCount, skinnedVertices, kernel); },
+      skinnedVertices);
+    const std::string name = std::string(getKernelName(kernel)) + " kernels, " + std::to_string(influenceCount) +
+                             " influences for all vertices";
+    matches &= verify(name.c_str(), seconds, skinnedVertices);
+  }
+
+  {
+    ThreadPool threadPool(std::thread::hardware_concurrency());
+    std::vector<std::vector<SkinnedVertex>> skinnedVertices;
+    const double seconds = measure(
+      [&vertices, &influenceRanges, &threadPool](const std::vector<BoneTransform>& boneTransforms,
+                                                 std::vector<SkinnedVertex>& skinnedVertices)
+      { skinVertices(threadPool, vertices, boneTransforms, influenceRanges, skinnedVertices); },
+      skinnedVertices);
+    const std::string name = std::to_string(threadPool.getThreadCount()) + " threads";
+    matches &= verify(name.c_str(), seconds, skinnedVertices);
+  }
+
+  return matches;
+}
+
+// Skins the posed instances with both skinning modes
+bool benchmarkSkinning(const char* fileName, int instanceCount)
+{
+  Model model;
+  bool loadedFromCache;
+  if (!loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
+
+  // Posing for dual quaternion skinning also updates the affine bone transforms
+  std::vector<Instance> instances = createInstances(model, instanceCount);
+  std::vector<std::vector<AffineTransform>> boneTransforms;
+  std::vector<std::vector<DualQuaternion>> boneDualQuaternions;
+  for (Instance& instance : instances)
+  {
+    updateAnimation(model, instance, 0.0, SkinningMode::DualQuaternion);
+    boneTransforms.push_back(instance.pose.boneTransforms);
+    boneDualQuaternions.push_back(instance.pose.boneDualQuaternions);
+  }
+  if (!isPaletteComplete(boneTransforms.front().size(), model.skeleton.bones.size()))
+  {
+    std::cerr << "Cannot skin the model " << fileName << " with " << boneTransforms.front().size()
+              << " bone transforms for " << model.skeleton.bones.size() << " bones\n";
+    return false;
+  }
+
+  const std::vector<Vertex>& vertices = model.mesh.vertices;
+  const std::vector<InfluenceRange> influenceRanges = getInfluenceRanges(vertices);
+  std::cout << "Model: " << fileName << " (" << vertices.size() << " vertices, " << model.skeleton.bones.size()
+            << " bones, " << model.mesh.influenceCount << " influences), " << instanceCount << " instances\n";
+
+  // How the vertices spread over the influence counts, rigid props and armour have most of them at 1
+  std::vector<size_t> influenceVertexCounts(static_cast<size_t>(maxInfluenceCount), 0u);
+  for (const InfluenceRange& range : influenceRanges)
+  {
+    influenceVertexCounts.at(static_cast<size_t>(range.influenceCount - 1)) += range.vertexCount;
+  }
+  std::cout << "Influence ranges: " << influenceRanges.size() << ", vertices by influence count:";
+  for (size_t i = 0u; i < influenceVertexCounts.size(); ++i)
+  {
+    std::cout << " " << i + 1u << ": "
+              << 100.0 * static_cast<double>(influenceVertexCounts.at(i)) / std::max(vertices.size(), size_t(1u))
+              << "%";
+  }
+  std::cout << "\n";
+
+  const bool linearBlendMatches =
+    benchmarkSkinning(SkinningMode::LinearBlend, vertices, influenceRanges, boneTransforms);
+  const bool dualQuaternionMatches =
+    benchmarkSkinning(SkinningMode::DualQuaternion, vertices, influenceRanges, boneDualQuaternions);
+  return linearBlendMatches && dualQuaternionMatches;
+}
+
+// Skins the vertices of the model repeated up to the vertex count with the widest kernels across the threads of a
+// thread pool, once unpacked and once in each packed vertex format that fits the bone count, and compares the memory,
+// the throughput and the error introduced by the quantization
+bool benchmarkVertexFormat(const char* fileName, int vertexCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  bool loadedFromCache;
+  if (!loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
+
+  Instance instance = createInstances(model, 1).at(0);
+  updateAnimation(model, instance, 0.0, SkinningMode::LinearBlend);
+  const std::vector<AffineTransform>& boneTransforms = instance.pose.boneTransforms;
+  const size_t boneCount = model.skeleton.bones.size();
+  if (!isPaletteComplete(boneTransforms.size(), boneCount))
+  {
+    std::cerr << "Cannot skin the model " << fileName << " with " << boneTransforms.size() << " bone transforms for "
+              << boneCount << " bones\n";
+    return false;
+  }
+
+  std::vector<Vertex> vertices(static_cast<size_t>(vertexCount));
+  for (size_t i = 0u; i < vertices.size(); ++i)
+  {
+    vertices.at(i) = model.mesh.vertices.at(i % model.mesh.vertices.size());
+  }
+
+  const std::vector<InfluenceRange> influenceRanges = getInfluenceRanges(vertices);
+
+  std::cout << "Model: " << fileName << " (" << model.mesh.vertices.size() << " vertices, " << boneCount
+            << " bones, " << getVertexFormatName(model.mesh.vertexFormat) << "), " << vertexCount << " vertices\n";
+
+  ThreadPool threadPool(std::thread::hardware_concurrency());
+  const double skinnedVertexCount = static_cast<double>(vertices.size()) * vertexFormatBenchmarkIterations;
+
+  // Skins the vertices a few times over, prints their memory and throughput and returns the seconds taken
+  const auto measure = [&](const char* name, const auto& formatVertices, std::vector<SkinnedVertex>& skinnedVertices)
+  {
+    const size_t vertexSize = sizeof(formatVertices.front());
+    const Clock::time_point start = Clock::now();
+    for (int iteration = 0; iteration < vertexFormatBenchmarkIterations; ++iteration)
+    {
+      skinVertices(threadPool, formatVertices, boneTransforms, influenceRanges, skinnedVertices);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << name << ": " << vertexSize << " bytes per vertex, "
+              << static_cast<double>(vertexSize * formatVertices.size()) / (1024.0 * 1024.0) << " MiB, "
+              << skinnedVertexCount / seconds / 1.0e6 << " million vertices/s\n";
+    return seconds;
+  };
+
+  // Returns the largest position error relative to the magnitude of the expected position and the largest error of a
+  // normal component
+  const auto compare = [](const std::vector<SkinnedVertex>& skinnedVertices, const std::vector<SkinnedVertex>& expected)
+  {
+    float maxPositionError = 0.0f, maxNormalError = 0.0f;
+    for (size_t i = 0u; i < skinnedVertices.size(); ++i)
+    {
+      const SkinnedVertex& a = skinnedVertices.at(i);
+      const SkinnedVertex& b = expected.at(i);
+      const glm::vec3 positionError = glm::abs(a.position - b.position) / glm::max(glm::abs(b.position), 1.0f);
+      maxPositionError = std::max(maxPositionError, glm::compMax(positionError));
+      maxNormalError = std::max(maxNormalError, glm::compMax(glm::abs(a.normal - b.normal)));
+    }
+    return std::make_pair(maxPositionError, maxNormalError);
+  };
+
+  std::vector<SkinnedVertex> unpackedSkinnedVertices;
+  const double unpackedSeconds = measure("Unpacked", vertices, unpackedSkinnedVertices);
+
+  // Packs the vertices, skins them and verifies them against the reference skinning of the same vertices unpacked
+  // again, which isolates the kernels from the quantization, returns true if they match
+  const auto benchmarkPacked = [&](VertexFormat vertexFormat, auto& packedVertices)
+  {
+    packVertices(vertices, packedVertices);
+    std::vector<SkinnedVertex> skinnedVertices;
+    const double seconds = measure(getVertexFormatName(vertexFormat), packedVertices, skinnedVertices);
+
+    std::vector<Vertex> unpackedVertices;
+    unpackVertices(packedVertices, unpackedVertices);
+    std::vector<SkinnedVertex> referenceSkinnedVertices(unpackedVertices.size());
+    skinVerticesReference(unpackedVertices, boneTransforms, 0u, unpackedVertices.size(), referenceSkinnedVertices);
+
+    const auto [positionError, normalError] = compare(skinnedVertices, referenceSkinnedVertices);
+    const auto [quantizationPositionError, quantizationNormalError] =
+      compare(skinnedVertices, unpackedSkinnedVertices);
+    const float maxError = std::max(positionError, normalError);
+    const bool matches = maxError <= skinningBenchmarkTolerance;
+    std::cout << "  " << unpackedSeconds / seconds << "x unpacked, "
+              << 100.0 * (1.0 - static_cast<double>(sizeof(packedVertices.front())) / sizeof(Vertex))
+              << "% less memory, quantization error " << quantizationPositionError << " (position), "
+              << quantizationNormalError << " (normal), max error " << maxError
+              << (matches ? "" : ", DOES NOT MATCH the reference") << "\n";
+    return matches;
+  };
+
+  bool matches = true;
+  if (chooseVertexFormat(boneCount) == VertexFormat::Packed8)
+  {
+    std::vector<PackedVertex8> packedVertices;
+    matches &= benchmarkPacked(VertexFormat::Packed8, packedVertices);
+  }
+  std::vector<PackedVertex16> packedVertices;
+  matches &= benchmarkPacked(VertexFormat::Packed16, packedVertices);
+  return matches;
+}
+
+// Reads the model file through Assimp and compares the post-transform vertex cache efficiency of its triangles in file
+// order against the mesh exactly as the import outputs it, batched, split by influence count and optimized, and the
+// size of its indices
+bool benchmarkMesh(const char* fileName)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Assimp::Importer importer;
+  std::unique_ptr<aiScene> syntheticScene;
+  const aiScene* scene = readScene(importer, syntheticScene, fileName);
+  if (!scene)
+  {
+    return false;
+  }
+  if (scene->mNumMeshes == 0u)
+  {
+    std::cerr << "The model " << fileName << " has no mesh\n";
+    return false;
+  }
+
+  // Gather the meshes in file order and batch them like the import does, the optimization only needs the positions
+  Mesh fileMesh;
+  for (unsigned int i = 0u; i < scene->mNumMeshes; ++i)
+  {
+    const aiMesh* mesh = scene->mMeshes[i];
+    if ((mesh->mPrimitiveTypes & (aiPrimitiveType_POINT | aiPrimitiveType_LINE)) != 0u)
+    {
+      continue;
+    }
+
+    const size_t baseVertex = fileMesh.vertices.size();
+    fileMesh.submeshes.push_back({ static_cast<uint32_t>(fileMesh.indices.size()), mesh->mNumFaces * 3u,
+                                   static_cast<uint32_t>(baseVertex), static_cast<uint32_t>(maxInfluenceCount) });
+    fileMesh.vertices.resize(baseVertex + mesh->mNumVertices);
+    for (unsigned int j = 0u; j < mesh->mNumVertices; ++j)
+    {
+      const aiVector3D& position = mesh->mVertices[j];
+      fileMesh.vertices.at(baseVertex + j).position = glm::vec3(position.x, position.y, position.z);
+    }
+    for (unsigned int j = 0u; j < mesh->mNumFaces; ++j)
+    {
+      const aiFace& face = mesh->mFaces[j];
+      fileMesh.indices.insert(fileMesh.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+    }
+  }
+  batchSubmeshes(fileMesh);
+
+  // Each draw range has its own vertices, so simulate the cache over each one and weight the ratios by their size
+  const auto analyzeMesh = [](const Mesh& mesh, size_t cacheSize)
+  {
+    VertexCacheStatistics statistics = { 0.0f, 0.0f };
+    for (const DrawRange& drawRange : getDrawRanges(mesh))
+    {
+      const std::vector<unsigned int> indices(mesh.indices.begin() + drawRange.firstIndex,
+                                              mesh.indices.begin() + drawRange.firstIndex + drawRange.indexCount);
+      const VertexCacheStatistics drawStatistics = analyzeVertexCache(indices, drawRange.vertexCount, cacheSize);
+      statistics.acmr += drawStatistics.acmr * static_cast<float>(indices.size() / 3u);
+      statistics.atvr += drawStatistics.atvr * static_cast<float>(drawRange.vertexCount);
+    }
+    statistics.acmr /= static_cast<float>(std::max(mesh.indices.size() / 3u, size_t(1u)));
+    statistics.atvr /= static_cast<float>(std::max(mesh.vertices.size(), size_t(1u)));
+    return statistics;
+  };
+
+  Mesh optimizedMesh;
+  const Clock::time_point start = Clock::now();
+  for (int iteration = 0; iteration < meshBenchmarkIterations; ++iteration)
+  {
+    Model model;
+    importScene(scene, model);
+    optimizedMesh = std::move(model.mesh);
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::cout << "Model: " << fileName << " (" << fileMesh.submeshes.size() << " meshes, " << fileMesh.vertices.size()
+            << " vertices, " << fileMesh.indices.size() / 3u << " triangles)\n";
+  std::cout << "Draw calls: " << getDrawRanges(optimizedMesh).size() << " (" << fileMesh.submeshes.size()
+            << " without batching)\n";
+  for (const size_t cacheSize : meshBenchmarkCacheSizes)
+  {
+    const VertexCacheStatistics fileStatistics = analyzeMesh(fileMesh, cacheSize);
+    const VertexCacheStatistics optimizedStatistics = analyzeMesh(optimizedMesh, cacheSize);
+    std::cout << "Cache of " << cacheSize << " vertices: ACMR " << fileStatistics.acmr << " -> "
+              << optimizedStatistics.acmr << ", ATVR " << fileStatistics.atvr << " -> " << optimizedStatistics.atvr
+              << "\n";
+  }
+
+  const IndexFormat indexFormat = chooseIndexFormat(getMaxDrawRangeVertexCount(optimizedMesh));
+  std::cout << "Indices: " << getIndexFormatName(indexFormat) << ", "
+            << getIndexSize(indexFormat) * optimizedMesh.indices.size() / 1024u << " KiB ("
+            << sizeof(unsigned int) * optimizedMesh.indices.size() / 1024u << " KiB as 32-bit)\n";
+  std::cout << "Import (mesh, skeleton and clips): " << seconds * 1.0e3 / meshBenchmarkIterations << " ms\n";
+  return true;
+}
+
+// Reads the model file through Assimp and compresses its first clip with the error bounds, reports how much smaller the
+// keyframes get, the largest error against the uncompressed clip and what decompressing and sampling the clip costs,
+// returns false if the error exceeds the bounds
+bool benchmarkCompression(const char* fileName, const ClipCompressionSettings& settings)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  {
+    Assimp::Importer importer;
+    std::unique_ptr<aiScene> syntheticScene;
+    const aiScene* scene = readScene(importer, syntheticScene, fileName);
+    if (!scene)
+    {
+      return false;
+    }
+    importScene(scene, model);
+  }
+  const Skeleton& skeleton = model.skeleton;
+  const Clip& clip = model.clips.getClip(0u);
+
+  const auto countKeyframes = [](const Clip& clip)
+  { return clip.translationKeyframes.size() + clip.rotationKeyframes.size() + clip.scaleKeyframes.size(); };
+  const auto countConstantTracks = [](const Clip& clip)
+  {
+    size_t count = 0u;
+    for (const std::vector<Track>* tracks : { &clip.translationTracks, &clip.rotationTracks, &clip.scaleTracks })
+    {
+      count += std::count_if(tracks->begin(), tracks->end(), [](const Track& track) { return track.count == 1u; });
+    }
+    return count;
+  };
+
+  // Compress
+  Clip reducedClip;
+  CompressedClip compressedClip;
+  const Clock::time_point compressionStart = Clock::now();
+  for (int iteration = 0; iteration < compressionBenchmarkIterations; ++iteration)
+  {
+    reducedClip = clip;
+    reduceKeyframes(skeleton, settings, reducedClip);
+    compressClip(reducedClip, compressedClip);
+  }
+  const double compressionSeconds = std::chrono::duration<double>(Clock::now() - compressionStart).count();
+
+  // Decompress
+  Clip decompressedClip;
+  const Clock::time_point decompressionStart = Clock::now();
+  for (int iteration = 0; iteration < compressionBenchmarkIterations; ++iteration)
+  {
+    decompressClip(compressedClip, decompressedClip);
+  }
+  const double decompressionSeconds = std::chrono::duration<double>(Clock::now() - decompressionStart).count();
+
+  // Sample both clips at 60 frames per second, fewer keyframes are found faster
+  const auto measureSampling = [&skeleton](const Clip& clip)
+  {
+    Pose pose;
+    pose.resize(skeleton.bones.size());
+    const Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < compressionBenchmarkFrameCount; ++frame)
+    {
+      updatePose(skeleton, clip, frame / 60.0, pose);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count() / compressionBenchmarkFrameCount;
+  };
+  const double samplingSeconds = measureSampling(clip);
+  const double compressedSamplingSeconds = measureSampling(decompressedClip);
+
+  const ClipError error = measureClipError(skeleton, clip, decompressedClip);
+  const bool withinBounds = error.position <= settings.maxPositionError && error.angle <= settings.maxAngleError;
+
+  const size_t keyframeCount = countKeyframes(clip), compressedKeyframeCount = countKeyframes(reducedClip);
+  const size_t memory = getKeyframeMemory(clip), compressedMemory = getKeyframeMemory(compressedClip);
+  std::cout << "Model: " << fileName << " (" << skeleton.bones.size() << " bones), clip "
+            << model.clips.getClipName(0u) << " (" << clip.duration << " s)\n";
+  std::cout << "Error bounds: " << settings.maxPositionError << " (position), " << settings.maxAngleError
+            << " degrees (angle)\n";
+  std::cout << "Keyframes: " << keyframeCount << " -> " << compressedKeyframeCount << ", constant tracks "
+            << countConstantTracks(clip) << " -> " << countConstantTracks(reducedClip) << "\n";
+  std::cout << "Keyframe memory: " << memory / 1024u << " KiB -> " << compressedMemory / 1024u << " KiB ("
+            << static_cast<double>(memory) / static_cast<double>(compressedMemory) << "x smaller)\n";
+  std::cout << "Max error: " << error.position << " (position), " << error.angle << " degrees (angle)"
+            << (withinBounds ? "" : ", EXCEEDS the bounds") << "\n";
+  std::cout << "Compression: " << compressionSeconds * 1.0e3 / compressionBenchmarkIterations << " ms\n";
+  std::cout << "Decompression: "
+            << decompressionSeconds * 1.0e9 / compressionBenchmarkIterations /
+                 static_cast<double>(std::max(compressedKeyframeCount, size_t(1u)))
+            << " ns per keyframe, " << decompressionSeconds * 1.0e3 / compressionBenchmarkIterations
+            << " ms per clip\n";
+  std::cout << "Sampling: " << samplingSeconds * 1.0e6 << " us per pose (" << compressedSamplingSeconds * 1.0e6
+            << " us compressed)\n";
+  return withinBounds;
+}
+
+// Caches a synthetic model with many clips in the temporary directory and compares loading it, which leaves the clips
+// compressed until they are played, against also decoding every clip up front, and measures switching an instance to
+// a clip that was not played before
+bool benchmarkClips(int clipCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  {
+    SyntheticRig rig;
+    rig.boneCount = clipBenchmarkBoneCount;
+    rig.depth = defaultHierarchyBenchmarkDepth;
+    rig.clipCount = clipCount;
+    rig.keyframeRate = clipBenchmarkKeyframeRate;
+    const std::unique_ptr<aiScene> scene = makeSyntheticScene(rig);
+    importScene(scene.get(), model);
+    compressClips(model.skeleton, ClipCompressionSettings(), model.clips);
+  }
+
+  const std::string fileName = (std::filesystem::temp_directory_path() / clipBenchmarkFileName).string();
+  if (!saveCache(fileName.c_str(), model))
+  {
+    return false;
+  }
+
+  // Lazy and eager loading
+  double lazySeconds = 0.0, eagerSeconds = 0.0;
+  for (int iteration = 0; iteration < clipBenchmarkIterations; ++iteration)
+  {
+    const Clock::time_point start = Clock::now();
+    if (!loadCache(fileName.c_str(), model))
+    {
+      std::cerr << "Failed to load model cache";
+      return false;
+    }
+    const Clock::time_point loaded = Clock::now();
+    for (size_t i = 0u; i < model.clips.getClipCount(); ++i)
+    {
+      model.clips.getClip(i);
+    }
+    lazySeconds += std::chrono::duration<double>(loaded - start).count();
+    eagerSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Switch a single instance through all clips, the first update after each switch decodes the clip
+  double firstUpdateSeconds = 0.0, updateSeconds = 0.0;
+  loadCache(fileName.c_str(), model);
+  std::vector<Instance> instances = createInstances(model, 1);
+  for (size_t i = 0u; i < model.clips.getClipCount(); ++i)
+  {
+    setClip(instances.at(0u), i);
+    const Clock::time_point start = Clock::now();
+    updateAnimation(model, instances.at(0u), 0.0, SkinningMode::LinearBlend);
+    const Clock::time_point decoded = Clock::now();
+    updateAnimation(model, instances.at(0u), crowdBenchmarkFrameTime, SkinningMode::LinearBlend);
+    firstUpdateSeconds += std::chrono::duration<double>(decoded - start).count();
+    updateSeconds += std::chrono::duration<double>(Clock::now() - decoded).count();
+  }
+
+  std::error_code error;
+  std::filesystem::remove(getCacheFileName(fileName.c_str()), error);
+
+  const double clipCountScale = 1.0 / static_cast<double>(model.clips.getClipCount());
+  std::cout << "Model: " << clipBenchmarkBoneCount << " bones, " << model.clips.getClipCount() << " clips with "
+            << clipBenchmarkKeyframeRate << " keyframes per second\n";
+  std::cout << "Load, clips decoded on first use: " << lazySeconds * 1.0e3 / clipBenchmarkIterations << " ms\n";
+  std::cout << "Load, clips decoded up front:     " << eagerSeconds * 1.0e3 / clipBenchmarkIterations << " ms\n";
+  std::cout << "Speedup: " << eagerSeconds / lazySeconds << "x\n";
+  std::cout << "First update after switching clips: " << firstUpdateSeconds * 1.0e6 * clipCountScale
+            << " us (" << updateSeconds * 1.0e6 * clipCountScale << " us once decoded)\n";
+  return true;
+}
+
+// Blends two clips sampled on a synthetic skeleton with each kernel and with per-bone glm interpolation as a reference
+// (the way a blend of whole bone transforms is written without the local pose lanes), then measures what crossfading,
+// masked and additive layers cost on top of playing a single clip per instance
+void benchmarkBlend(int instanceCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  {
+    SyntheticRig rig;
+    rig.boneCount = defaultPoseBenchmarkBoneCount;
+    rig.depth = defaultHierarchyBenchmarkDepth;
+    rig.clipCount = 3;
+    rig.keyframeRate = poseBenchmarkKeyframeRate;
+    const std::unique_ptr<aiScene> scene = makeSyntheticScene(rig);
+    importScene(scene.get(), model);
+  }
+
+  Clip additiveClip;
+  makeAdditiveClip(model.clips.getClip(2u), model.clips.getClip(0u), additiveClip);
+  model.clips.addClip("Additive", std::move(additiveClip));
+  const size_t additiveClipIndex = model.clips.getClipCount() - 1u;
+
+  const size_t boneCount = model.skeleton.bones.size();
+  std::vector<Cursor> cursors(boneCount);
+  LocalPose a, b, result;
+  a.resize(boneCount);
+  b.resize(boneCount);
+  result.resize(boneCount);
+  sampleClip(model.clips.getClip(0u), 0.25, cursors, a);
+  std::fill(cursors.begin(), cursors.end(), Cursor());
+  sampleClip(model.clips.getClip(1u), 0.5, cursors, b);
+
+  std::cout << "Skeleton: " << boneCount << " bones, " << getPaddedBoneCount(boneCount) << " lanes\n";
+
+  // Per-bone glm interpolation, lerp for translation and scale and slerp for rotation
+  std::vector<glm::vec3> translations(boneCount), scales(boneCount);
+  std::vector<glm::quat> rotations(boneCount);
+  double referenceSeconds;
+  {
+    const Clock::time_point start = Clock::now();
+    for (int iteration = 0; iteration < blendBenchmarkIterations; ++iteration)
+    {
+      const float weight = static_cast<float>(iteration % 100) / 100.0f;
+      for (size_t i = 0u; i < boneCount; ++i)
+      {
+        const glm::quat from(a.rotationW[i], a.rotationX[i], a.rotationY[i], a.rotationZ[i]);
+        const glm::quat to(b.rotationW[i], b.rotationX[i], b.rotationY[i], b.rotationZ[i]);
+        translations[i] = glm::mix(glm::vec3(a.translationX[i], a.translationY[i], a.translationZ[i]),
+                                   glm::vec3(b.translationX[i], b.translationY[i], b.translationZ[i]), weight);
+        rotations[i] = glm::slerp(from, to, weight);
+        scales[i] = glm::mix(glm::vec3(a.scaleX[i], a.scaleY[i], a.scaleZ[i]),
+                             glm::vec3(b.scaleX[i], b.scaleY[i], b.scaleZ[i]), weight);
+      }
+    }
+    referenceSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  std::cout << "Per-bone glm slerp: " << blendBenchmarkIterations / referenceSeconds / 1.0e6
+            << " million blends/s\n";
+
+  // Local pose blends with each kernel, the scalar kernel comes first
+  LocalPose scalarBlend, scalarAdd;
+  for (const Kernel kernel : getKernels())
+  {
+    const Clock::time_point start = Clock::now();
+    for (int iteration = 0; iteration < blendBenchmarkIterations; ++iteration)
+    {
+      blendLocalPoses(a, b, static_cast<float>(iteration % 100) / 100.0f, nullptr, result, kernel);
+    }
+    const Clock::time_point blended = Clock::now();
+    for (int iteration = 0; iteration < blendBenchmarkIterations; ++iteration)
+    {
+      addLocalPose(a, b, static_cast<float>(iteration % 100) / 100.0f, nullptr, result, kernel);
+    }
+    const double blendSeconds = std::chrono::duration<double>(blended - start).count();
+    const double addSeconds = std::chrono::duration<double>(Clock::now() - blended).count();
+
+    // Compare the last weights of both against the scalar kernel
+    LocalPose blend = result, add = result;
+    blendLocalPoses(a, b, blendBenchmarkCheckWeight, nullptr, blend, kernel);
+    addLocalPose(a, b, blendBenchmarkCheckWeight, nullptr, add, kernel);
+    if (kernel == Kernel::Scalar)
+    {
+      scalarBlend = blend;
+      scalarAdd = add;
+    }
+
+    float maxError = 0.0f;
+    for (std::vector<float> LocalPose::*lanes :
+         { &LocalPose::translationX, &LocalPose::translationY, &LocalPose::translationZ, &LocalPose::rotationX,
+           &LocalPose::rotationY, &LocalPose::rotationZ, &LocalPose::rotationW, &LocalPose::scaleX,
+           &LocalPose::scaleY, &LocalPose::scaleZ })
+    {
+      for (size_t i = 0u; i < boneCount; ++i)
+      {
+        maxError = std::max(maxError, std::abs((blend.*lanes)[i] - (scalarBlend.*lanes)[i]));
+        maxError = std::max(maxError, std::abs((add.*lanes)[i] - (scalarAdd.*lanes)[i]));
+      }
+    }
+
+    std::cout << getKernelName(kernel) << " kernels: " << blendBenchmarkIterations / blendSeconds / 1.0e6
+              << " million blends/s (" << referenceSeconds / blendSeconds << "x per-bone glm), "
+              << blendBenchmarkIterations / addSeconds / 1.0e6 << " million additive blends/s, max error "
+              << maxError << "\n";
+  }
+
+  // Whole instance updates with layers, the upper body is the first chain below the root bone
+  const BoneMask upperBodyMask = makeBoneMask(model.skeleton, 1, 1.0f, 0.0f);
+  const auto measureInstances = [&](const char* name, auto addLayers)
+  {
+    std::vector<Instance> instances = createInstances(model, instanceCount);
+    for (Instance& instance : instances)
+    {
+      addLayers(instance);
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < crowdBenchmarkFrameCount; ++frame)
+    {
+      for (Instance& instance : instances)
+      {
+        updateAnimation(model, instance, frame * crowdBenchmarkFrameTime, SkinningMode::LinearBlend);
+      }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double rate = static_cast<double>(instanceCount) * crowdBenchmarkFrameCount / seconds;
+    std::cout << name << ": " << rate << " instances/s\n";
+    return rate;
+  };
+
+  std::cout << instanceCount << " instances on a single thread\n";
+  const double singleClipRate = measureInstances("Single clip", [](Instance&) {});
+  const double crossfadeRate =
+    measureInstances("Crossfade",
+                     [](Instance& instance) { addLayer(instance, 1u, BlendMode::Override, nullptr).weight = 0.5f; });
+  const double layeredRate =
+    measureInstances("Crossfade, upper body and additive layers",
+                     [&](Instance& instance)
+                     {
+                       addLayer(instance, 1u, BlendMode::Override, nullptr).weight = 0.5f;
+                       addLayer(instance, 2u, BlendMode::Override, &upperBodyMask).weight = 1.0f;
+                       addLayer(instance, additiveClipIndex, BlendMode::Additive, nullptr).weight = 0.5f;
+                     });
+  std::cout << "Relative cost: " << singleClipRate / crossfadeRate << "x for a crossfade, "
+            << singleClipRate / layeredRate << "x for three layers\n";
+}
+
+// Renders a few seconds of virtual frames at common display rates and compares posing the instances every frame
+// against simulating them at a fixed rate and interpolating between the last two steps every frame
+bool benchmarkTimestep(const char* fileName, int instanceCount, double simulationRate)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Model model;
+  bool loadedFromCache;
+  if (!loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
+
+  const size_t boneCount = model.skeleton.bones.size();
+  std::vector<AffineTransform> palette(boneCount * static_cast<size_t>(instanceCount));
+  std::cout << "Model: " << fileName << " (" << boneCount << " bones), " << instanceCount << " instances, "
+            << simulationRate << " steps per second\n";
+
+  for (const double displayRate : timestepBenchmarkDisplayRates)
+  {
+    const int frameCount = static_cast<int>(displayRate * timestepBenchmarkSeconds);
+
+    // Pose every frame
+    std::vector<Instance> instances = createInstances(model, instanceCount);
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+      for (size_t i = 0u; i < instances.size(); ++i)
+      {
+        updateAnimation(model, instances[i], frame / displayRate, SkinningMode::LinearBlend);
+        std::copy(instances[i].pose.boneTransforms.begin(), instances[i].pose.boneTransforms.end(),
+                  &palette[i * boneCount]);
+      }
+    }
+    const double frameSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Pose at the fixed rate and interpolate every frame
+    instances = createInstances(model, instanceCount);
+    FixedTimestep timestep(simulationRate);
+    int stepCount = 0;
+    start = Clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+      timestep.advance(frame / displayRate, timestepBenchmarkMaxStepCount);
+      double time;
+      while (timestep.step(time))
+      {
+        for (Instance& instance : instances)
+        {
+          updateAnimation(model, instance, time, SkinningMode::LinearBlend);
+        }
+        ++stepCount;
+      }
+
+      const float factor = timestep.getInterpolationFactor();
+      for (size_t i = 0u; i < instances.size(); ++i)
+      {
+        interpolateBoneTransforms(model.skeleton, instances[i].pose, factor, &palette[i * boneCount]);
+      }
+    }
+    const double stepSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << displayRate << " Hz display: " << frameSeconds * 1.0e3 / timestepBenchmarkSeconds
+              << " ms per second posing every frame, " << stepSeconds * 1.0e3 / timestepBenchmarkSeconds
+              << " ms per second with " << stepCount << " fixed steps (" << frameSeconds / stepSeconds << "x)\n";
+  }
+  return true;
+}
+
+// Measures the cost of an empty profiled scope, then profiles posing a crowd across the threads of a thread pool and
+// writes the trace to the temporary directory
+bool benchmarkProfiler(const char* fileName, int instanceCount)
+{
+  using Clock = std::chrono::steady_clock;
+
+  if (!isProfilerEnabled())
+  {
+    std::cout << "The profiler is compiled out of this build\n";
+    return true;
+  }
+
+  // Scopes that wrap around the ring buffer cost the same as any others
+  const Clock::time_point start = Clock::now();
+  for (int i = 0; i < profilerBenchmarkScopeCount; ++i)
+  {
+    POSER_PROFILE_SCOPE("Empty scope");
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Empty scope: " << seconds * 1.0e9 / profilerBenchmarkScopeCount << " ns\n";
+  resetProfiler();
+
+  Model model;
+  bool loadedFromCache;
+  if (!loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
+
+  std::vector<Instance> instances = createInstances(model, instanceCount);
+  {
+    ThreadPool threadPool(std::thread::hardware_concurrency());
+    for (int frame = 0; frame < crowdBenchmarkFrameCount; ++frame)
+    {
+      POSER_PROFILE_SCOPE("Frame");
+      updateAnimations(threadPool, model, instances, frame * crowdBenchmarkFrameTime, SkinningMode::LinearBlend);
+    }
+  }
+
+  printProfileStats(std::cout);
+  const std::string traceFileName = (std::filesystem::temp_directory_path() / profilerBenchmarkTraceFileName).string();
+  if (!writeChromeTrace(traceFileName.c_str()))
+  {
+    return false;
+  }
+  std::cout << "Trace: " << traceFileName << "\n";
+  return true;
+}
+
+} // namespace
+
+bool runBenchmark(int argc, char* argv[], const char* fileName, int& exitCode)
+{
+  if (argc < 2)
+  {
+    return false;
+  }
+
+  const char* mode = argv[1];
+  if (std::strcmp(mode, "--bench-load") == 0)
+  {
+    const int iterations = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultLoadBenchmarkIterations;
+    exitCode = benchmarkLoad(fileName, iterations) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-hierarchy") == 0)
+  {
+    const int boneCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultHierarchyBenchmarkBoneCount;
+    const int depth = argc > 3 ? std::max(std::atoi(argv[3]), 1) : defaultHierarchyBenchmarkDepth;
+    const int branchingFactor =
+      argc > 4 ? std::max(std::atoi(argv[4]), 1) : defaultHierarchyBenchmarkBranchingFactor;
+    benchmarkHierarchy(boneCount, depth, branchingFactor);
+    exitCode = EXIT_SUCCESS;
+  }
+  else if (std::strcmp(mode, "--bench-pose") == 0)
+  {
+    const int boneCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultPoseBenchmarkBoneCount;
+    const int depth = argc > 3 ? std::max(std::atoi(argv[3]), 1) : defaultHierarchyBenchmarkDepth;
+    exitCode = benchmarkPose(boneCount, depth) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-crowd") == 0)
+  {
+    const int instanceCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultCrowdBenchmarkInstanceCount;
+    exitCode = benchmarkCrowd(fileName, instanceCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-import") == 0)
+  {
+    const int nodeCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultImportBenchmarkNodeCount;
+    const int boneCount = argc > 3 ? std::max(std::atoi(argv[3]), 1) : defaultImportBenchmarkBoneCount;
+    benchmarkImport(nodeCount, boneCount);
+    exitCode = EXIT_SUCCESS;
+  }
+  else if (std::strcmp(mode, "--bench-skinning") == 0)
+  {
+    const int instanceCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultSkinningBenchmarkInstanceCount;
+    exitCode = benchmarkSkinning(fileName, instanceCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-compression") == 0)
+  {
+    ClipCompressionSettings settings;
+    settings.maxPositionError = argc > 2 ? static_cast<float>(std::atof(argv[2])) : settings.maxPositionError;
+    settings.maxAngleError = argc > 3 ? static_cast<float>(std::atof(argv[3])) : settings.maxAngleError;
+    exitCode = benchmarkCompression(fileName, settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-clips") == 0)
+  {
+    const int clipCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultClipBenchmarkClipCount;
+    exitCode = benchmarkClips(clipCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-blend") == 0)
+  {
+    const int instanceCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultBlendBenchmarkInstanceCount;
+    benchmarkBlend(instanceCount);
+    exitCode = EXIT_SUCCESS;
+  }
+  else if (std::strcmp(mode, "--bench-timestep") == 0)
+  {
+    const int instanceCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultCrowdBenchmarkInstanceCount;
+    const double simulationRate =
+      argc > 3 ? std::max(std::atof(argv[3]), 1.0) : defaultTimestepBenchmarkSimulationRate;
+    exitCode = benchmarkTimestep(fileName, instanceCount, simulationRate) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-profiler") == 0)
+  {
+    const int instanceCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultCrowdBenchmarkInstanceCount;
+    exitCode = benchmarkProfiler(fileName, instanceCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-mesh") == 0)
+  {
+    exitCode = benchmarkMesh(fileName) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else if (std::strcmp(mode, "--bench-vertex-format") == 0)
+  {
+    const int vertexCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultVertexFormatBenchmarkVertexCount;
+    exitCode = benchmarkVertexFormat(fileName, vertexCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace poser
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace poser
+{
+
+// Runs the benchmark mode (one of the --bench-* options of poser_bench) selected by the first argument on the model
+// file, none of them needs a window or OpenGL, returns false if the arguments do not select a benchmark mode, otherwise
+// sets the exit code for the process
+bool runBenchmark(int argc, char* argv[], const char* fileName, int& exitCode);
+
+} // namespace poser
@@ -0,0 +1,215 @@
+#include "Blend.h"
+
+#include "Lanes.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <cassert>
+
+namespace poser
+{
+
+namespace
+{
+
+// The translation and scale lanes of the local pose, which blend component by component, and its rotation lanes, which
+// blend as quaternions
+constexpr std::vector<float> LocalPose::*vectorLanes[] = { &LocalPose::translationX, &LocalPose::translationY,
+                                                           &LocalPose::translationZ, &LocalPose::scaleX,
+                                                           &LocalPose::scaleY,       &LocalPose::scaleZ };
+constexpr std::vector<float> LocalPose::*rotationLanes[] = { &LocalPose::rotationX, &LocalPose::rotationY,
+                                                             &LocalPose::rotationZ, &LocalPose::rotationW };
+
+// Returns the blend factor of the bones starting at the index
+template<typename Lanes>
+Lanes getBlendFactor(Lanes weight, const BoneMask* mask, size_t index)
+{
+  return mask != nullptr ? Lanes::load(&mask->weights[index]) * weight : weight;
+}
+
+// Loads the rotations of the bones starting at the index
+template<typename Lanes>
+void loadRotations(const LocalPose& pose, size_t index, Lanes (&rotations)[4])
+{
+  for (int component = 0; component < 4; ++component)
+  {
+    rotations[component] = Lanes::load(&(pose.*rotationLanes[component])[index]);
+  }
+}
+
+// Stores the rotations of the bones starting at the index
+template<typename Lanes>
+void storeRotations(const Lanes (&rotations)[4], size_t index, LocalPose& pose)
+{
+  for (int component = 0; component < 4; ++component)
+  {
+    rotations[component].store(&(pose.*rotationLanes[component])[index]);
+  }
+}
+
+// Blends the local poses with the kernels of the given lanes
+template<typename Lanes>
+void blendLocalPoses(const LocalPose& a, const LocalPose& b, float weight, const BoneMask* mask, LocalPose& result)
+{
+  assert(mask == nullptr || mask->weights.size() == a.translationX.size());
+
+  const Lanes weightLanes = Lanes::broadcast(weight);
+  for (size_t i = 0u; i < a.translationX.size(); i += Lanes::width)
+  {
+    const Lanes factor = getBlendFactor(weightLanes, mask, i);
+
+    // Translation and scale
+    for (std::vector<float> LocalPose::*lanes : vectorLanes)
+    {
+      const Lanes from = Lanes::load(&(a.*lanes)[i]), to = Lanes::load(&(b.*lanes)[i]);
+      (from + (to - from) * factor).store(&(result.*lanes)[i]);
+    }
+
+    // Rotation
+    Lanes from[4], to[4], rotation[4];
+    loadRotations(a, i, from);
+    loadRotations(b, i, to);
+    nlerpQuaternions(from, to, factor, rotation);
+    storeRotations(rotation, i, result);
+  }
+}
+
+// Adds the additive local pose to the base local pose with the kernels of the given lanes, translations add, scales
+// multiply and rotations rotate by the additive rotation in bone space, all scaled from no change by the blend factor
+template<typename Lanes>
+void addLocalPose(const LocalPose& base,
+                  const LocalPose& additive,
+                  float weight,
+                  const BoneMask* mask,
+                  LocalPose& result)
+{
+  assert(mask == nullptr || mask->weights.size() == base.translationX.size());
+
+  const Lanes weightLanes = Lanes::broadcast(weight), zero = Lanes::broadcast(0.0f), one = Lanes::broadcast(1.0f);
+  const Lanes identity[4] = { zero, zero, zero, one };
+  for (size_t i = 0u; i < base.translationX.size(); i += Lanes::width)
+  {
+    const Lanes factor = getBlendFactor(weightLanes, mask, i);
+
+    // Translation
+    for (std::vector<float> LocalPose::*lanes : { &LocalPose::translationX, &LocalPose::translationY,
+                                                  &LocalPose::translationZ })
+    {
+      const Lanes from = Lanes::load(&(base.*lanes)[i]), difference = Lanes::load(&(additive.*lanes)[i]);
+      (from + difference * factor).store(&(result.*lanes)[i]);
+    }
+
+    // Scale
+    for (std::vector<float> LocalPose::*lanes : { &LocalPose::scaleX, &LocalPose::scaleY, &LocalPose::scaleZ })
+    {
+      const Lanes from = Lanes::load(&(base.*lanes)[i]), ratio = Lanes::load(&(additive.*lanes)[i]);
+      (from * (one + (ratio - one) * factor)).store(&(result.*lanes)[i]);
+    }
+
+    // Rotation
+    Lanes from[4], difference[4], weightedDifference[4], rotation[4];
+    loadRotations(base, i, from);
+    loadRotations(additive, i, difference);
+    nlerpQuaternions(identity, difference, factor, weightedDifference);
+    multiplyQuaternions(from, weightedDifference, rotation);
+    storeRotations(rotation, i, result);
+  }
+}
+
+} // namespace
+
+BoneMask makeBoneMask(const Skeleton& skeleton, int rootBone, float insideWeight, float outsideWeight)
+{
+  const std::vector<Bone>& bones = skeleton.bones;
+  BoneMask mask;
+  mask.weights.assign(getPaddedBoneCount(bones.size()), 0.0f);
+
+  // The bones are sorted so that each parent comes before its children, so a single pass finds all descendants
+  std::vector<bool> inside(bones.size(), false);
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    const int parent = bones.at(i).parent;
+    inside.at(i) = static_cast<int>(i) == rootBone || (parent >= 0 && inside.at(parent));
+    mask.weights.at(i) = inside.at(i) ? insideWeight : outsideWeight;
+  }
+  return mask;
+}
+
+void blendLocalPoses(const LocalPose& a, const LocalPose& b, float weight, const BoneMask* mask, LocalPose& result)
+{
+  blendLocalPoses<SimdLanes>(a, b, weight, mask, result);
+}
+
+void blendLocalPoses(const LocalPose& a,
+                     const LocalPose& b,
+                     float weight,
+                     const BoneMask* mask,
+                     LocalPose& result,
+                     Kernel kernel)
+{
+  dispatchKernel(kernel, [&](auto lanes) { blendLocalPoses<decltype(lanes)>(a, b, weight, mask, result); });
+}
+
+void addLocalPose(const LocalPose& base,
+                  const LocalPose& additive,
+                  float weight,
+                  const BoneMask* mask,
+                  LocalPose& result)
+{
+  addLocalPose<SimdLanes>(base, additive, weight, mask, result);
+}
+
+void addLocalPose(const LocalPose& base,
+                  const LocalPose& additive,
+                  float weight,
+                  const BoneMask* mask,
+                  LocalPose& result,
+                  Kernel kernel)
+{
+  dispatchKernel(kernel, [&](auto lanes) { addLocalPose<decltype(lanes)>(base, additive, weight, mask, result); });
+}
+
+void makeAdditiveClip(const Clip& clip, const Clip& reference, Clip& additiveClip)
+{
+  additiveClip = clip;
+  for (size_t i = 0u; i < clip.translationTracks.size(); ++i)
+  {
+    // Tracks without keyframes in the reference clip are relative to the identity transform
+    const Track& referenceTranslationTrack = reference.translationTracks.at(i);
+    const Track& referenceRotationTrack = reference.rotationTracks.at(i);
+    const Track& referenceScaleTrack = reference.scaleTracks.at(i);
+    const glm::vec3 referenceTranslation = referenceTranslationTrack.count > 0u
+                                             ? reference.translationKeyframes.at(referenceTranslationTrack.first)
+                                             : glm::vec3(0.0f);
+    const glm::quat inverseReferenceRotation =
+      glm::conjugate(referenceRotationTrack.count > 0u ? reference.rotationKeyframes.at(referenceRotationTrack.first)
+                                                       : glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    const glm::vec3 referenceScale =
+      referenceScaleTrack.count > 0u ? reference.scaleKeyframes.at(referenceScaleTrack.first) : glm::vec3(1.0f);
+
+    const Track& translationTrack = clip.translationTracks.at(i);
+    for (uint32_t j = translationTrack.first; j < translationTrack.first + translationTrack.count; ++j)
+    {
+      additiveClip.translationKeyframes.at(j) -= referenceTranslation;
+    }
+
+    const Track& rotationTrack = clip.rotationTracks.at(i);
+    for (uint32_t j = rotationTrack.first; j < rotationTrack.first + rotationTrack.count; ++j)
+    {
+      additiveClip.rotationKeyframes.at(j) = glm::normalize(inverseReferenceRotation * clip.rotationKeyframes.at(j));
+    }
+
+    // Scale components of zero in the reference would divide by zero, leave them unchanged instead
+    const Track& scaleTrack = clip.scaleTracks.at(i);
+    for (uint32_t j = scaleTrack.first; j < scaleTrack.first + scaleTrack.count; ++j)
+    {
+      glm::vec3& scale = additiveClip.scaleKeyframes.at(j);
+      for (int component = 0; component < 3; ++component)
+      {
+        scale[component] = referenceScale[component] != 0.0f ? scale[component] / referenceScale[component] : 1.0f;
+      }
+    }
+  }
+}
+
+} // namespace poser
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Clip.h"
+#include "Kernel.h"
+#include "Pose.h"
+#include "Skeleton.h"
+
+#include <vector>
+
+namespace poser
+{
+
+// How a layer combines with the local pose below it, override layers blend towards their own pose while additive
+// layers add the difference of their clip to a reference pose (see makeAdditiveClip) on top of it
+enum class BlendMode
+{
+  Override,
+  Additive
+};
+
+// Bone mask definition, the weight of each bone in a blend, for example to only blend the upper body of a character
+struct BoneMask
+{
+  std::vector<float> weights; // Indexed like the bones, padded like the local pose with zero weights
+};
+
+// Builds a mask with the inside weight for the bone and its descendants and the outside weight for all other bones
+BoneMask makeBoneMask(const Skeleton& skeleton, int rootBone, float insideWeight, float outsideWeight);
+
+// Blends from local pose a to local pose b by the weight (0 is a, 1 is b) scaled by the mask of each bone or by the
+// weight alone if the mask is null, lerp for translation and scale and normalized lerp along the shorter arc for
+// rotation, with the widest kernels available, the result may be either of the poses
+void blendLocalPoses(const LocalPose& a, const LocalPose& b, float weight, const BoneMask* mask, LocalPose& result);
+
+// Blends the local poses with the given kernels, which must be available in this build
+void blendLocalPoses(const LocalPose& a,
+                     const LocalPose& b,
+                     float weight,
+                     const BoneMask* mask,
+                     LocalPose& result,
+                     Kernel kernel);
+
+// Adds the additive local pose (sampled from an additive clip) to the base local pose by the weight scaled by the mask
+// of each bone or by the weight alone if the mask is null, with the widest kernels available, the result may be either
+// of the poses
+void addLocalPose(const LocalPose& base,
+                  const LocalPose& additive,
+                  float weight,
+                  const BoneMask* mask,
+                  LocalPose& result);
+
+// Adds the additive local pose with the given kernels, which must be available in this build
+void addLocalPose(const LocalPose& base,
+                  const LocalPose& additive,
+                  float weight,
+                  const BoneMask* mask,
+                  LocalPose& result,
+                  Kernel kernel);
+
+// Converts the clip into an additive clip, the difference of each keyframe to the first keyframe of the same track in
+// the reference clip, so that adding it at full weight to the reference pose plays the clip
+void makeAdditiveClip(const Clip& clip, const Clip& reference, Clip& additiveClip);
+
+} // namespace poser
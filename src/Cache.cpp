@@ -0,0 +1,549 @@
+#include "Cache.h"
+
+#include "Profiler.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+  #define NOMINMAX
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace poser
+{
+
+namespace
+{
+
+// Model cache definitions, the cache file is a header followed by the packed vertices, the indices in the index format,
+// the submeshes, the bones and the clips, each clip is a clip header followed by its name, the tracks of each bone, the
+// quantized translation, rotation and scale keyframes and finally their times, each section padded to 4 bytes
+struct CacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexSize;   // Guards against changes to the packed vertex definition
+  uint32_t vertexFormat; // Format of the packed vertices
+  uint32_t influenceCount;
+  uint32_t indexFormat;
+  uint32_t vertexCount, indexCount, submeshCount, boneCount, clipCount;
+};
+
+struct CacheBone
+{
+  AffineTransform inverseBindMatrix;
+  int32_t parentIndex; // Index of the parent bone, always lower than the index of this bone, -1 for root bones
+};
+
+struct CacheClipHeader
+{
+  uint32_t nameLength;
+  uint32_t translationKeyframeCount, rotationKeyframeCount, scaleKeyframeCount;
+  float duration;
+};
+
+struct CacheTracks
+{
+  Track translationTrack, rotationTrack, scaleTrack;
+  TrackRange translationRange, scaleRange; // Of the quantized keyframes
+};
+
+// Read-only memory mapping of an entire file
+struct MappedFile
+{
+  explicit MappedFile(const std::filesystem::path& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const unsigned char* data = nullptr;
+  size_t size = 0u;
+
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#endif
+};
+
+// Cache constants
+constexpr char cacheFileExtension[] = ".poser"; // Appended to the model file name
+constexpr char cacheMagic[4] = { 'P', 'O', 'S', 'R' };
+constexpr uint32_t cacheVersion = 17u; // Increment whenever the cache layout or its contents change
+
+// Rounds the size of a section up so that the next section stays 4-byte aligned
+size_t alignSection(size_t size)
+{
+  return (size + 3u) & ~size_t(3u);
+}
+
+// Writes the section followed by the padding that keeps the next section aligned
+void writeSection(std::ofstream& file, const void* data, size_t size)
+{
+  constexpr char padding[4] = {};
+  file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  file.write(padding, static_cast<std::streamsize>(alignSection(size) - size));
+}
+
+// Returns the section of that many elements at the offset and advances the offset past it and its padding, returns
+// nullptr if the section does not fit into the file
+template<typename T>
+const T* readSection(const MappedFile& file, size_t& offset, size_t count)
+{
+  const size_t size = alignSection(sizeof(T) * count);
+  if (size > file.size - offset)
+  {
+    return nullptr;
+  }
+
+  const T* section = reinterpret_cast<const T*>(file.data + offset);
+  offset += size;
+  return section;
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+  file =
+    CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+  {
+    return;
+  }
+
+  mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    return;
+  }
+
+  data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (data)
+  {
+    size = static_cast<size_t>(fileSize.QuadPart);
+  }
+#else
+  const int file = open(path.c_str(), O_RDONLY);
+  if (file < 0)
+  {
+    return;
+  }
+
+  struct stat fileInfo;
+  if (fstat(file, &fileInfo) == 0 && fileInfo.st_size > 0)
+  {
+    void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    if (view != MAP_FAILED)
+    {
+      data = static_cast<const unsigned char*>(view);
+      size = static_cast<size_t>(fileInfo.st_size);
+    }
+  }
+
+  close(file); // The mapping stays valid after the file descriptor is closed
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+  if (data)
+  {
+    UnmapViewOfFile(data);
+  }
+
+  if (mapping)
+  {
+    CloseHandle(mapping);
+  }
+
+  if (file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(file);
+  }
+#else
+  if (data)
+  {
+    munmap(const_cast<unsigned char*>(data), size);
+  }
+#endif
+}
+
+} // namespace
+
+std::filesystem::path getCacheFileName(const char* fileName)
+{
+  std::filesystem::path cacheFileName = fileName;
+  cacheFileName += cacheFileExtension;
+  return cacheFileName;
+}
+
+bool isCacheUpToDate(const char* fileName)
+{
+  std::error_code error;
+  const std::filesystem::file_time_type cacheTime = std::filesystem::last_write_time(getCacheFileName(fileName), error);
+  if (error)
+  {
+    return false;
+  }
+
+  const std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(fileName, error);
+  return error || sourceTime <= cacheTime;
+}
+
+bool saveCache(const char* fileName, const Model& model)
+{
+  POSER_PROFILE_SCOPE("Save cache");
+  const Mesh& mesh = model.mesh;
+  const std::vector<Bone>& bones = model.skeleton.bones;
+  const ClipLibrary& clips = model.clips;
+
+  const std::filesystem::path cacheFileName = getCacheFileName(fileName);
+
+  // Write to a temporary file first so that an interrupted write never leaves a truncated cache behind
+  std::filesystem::path temporaryFileName = cacheFileName;
+  temporaryFileName += ".tmp";
+  {
+    std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+      std::cerr << "Failed to create model cache " << temporaryFileName << "\n";
+      return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.vertexSize = static_cast<uint32_t>(getPackedVertexSize(mesh.vertexFormat));
+    header.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+    header.influenceCount = static_cast<uint32_t>(mesh.influenceCount);
+    header.indexFormat = static_cast<uint32_t>(mesh.indexFormat);
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    header.submeshCount = static_cast<uint32_t>(mesh.submeshes.size());
+    header.boneCount = static_cast<uint32_t>(bones.size());
+    header.clipCount = static_cast<uint32_t>(clips.getClipCount());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Only the packed vertices are stored, the vertices are unpacked from them on load
+    if (mesh.vertexFormat == VertexFormat::Packed8)
+    {
+      writeSection(file, mesh.packedVertices8.data(), sizeof(PackedVertex8) * mesh.packedVertices8.size());
+    }
+    else
+    {
+      writeSection(file, mesh.packedVertices16.data(), sizeof(PackedVertex16) * mesh.packedVertices16.size());
+    }
+    if (mesh.indexFormat == IndexFormat::Index16)
+    {
+      writeSection(file, mesh.packedIndices16.data(), sizeof(uint16_t) * mesh.packedIndices16.size());
+    }
+    else
+    {
+      writeSection(file, mesh.indices.data(), sizeof(unsigned int) * mesh.indices.size());
+    }
+    writeSection(file, mesh.submeshes.data(), sizeof(Submesh) * mesh.submeshes.size());
+
+    for (const Bone& bone : bones)
+    {
+      const CacheBone cacheBone = { bone.inverseBindMatrix, static_cast<int32_t>(bone.parent) };
+      file.write(reinterpret_cast<const char*>(&cacheBone), sizeof(cacheBone));
+    }
+
+    // Clips are stored compressed, which only compresses those that were added decoded
+    for (size_t i = 0u; i < clips.getClipCount(); ++i)
+    {
+      const std::string& name = clips.getClipName(i);
+      const CompressedClip& clip = clips.getCompressedClip(i);
+
+      CacheClipHeader clipHeader;
+      clipHeader.nameLength = static_cast<uint32_t>(name.size());
+      clipHeader.translationKeyframeCount = static_cast<uint32_t>(clip.translationKeyframes.size());
+      clipHeader.rotationKeyframeCount = static_cast<uint32_t>(clip.rotationKeyframes.size());
+      clipHeader.scaleKeyframeCount = static_cast<uint32_t>(clip.scaleKeyframes.size());
+      clipHeader.duration = clip.duration;
+      file.write(reinterpret_cast<const char*>(&clipHeader), sizeof(clipHeader));
+      writeSection(file, name.data(), name.size());
+
+      for (size_t j = 0u; j < bones.size(); ++j)
+      {
+        const CacheTracks cacheTracks = { clip.translationTracks.at(j), clip.rotationTracks.at(j),
+                                          clip.scaleTracks.at(j), clip.translationRanges.at(j),
+                                          clip.scaleRanges.at(j) };
+        file.write(reinterpret_cast<const char*>(&cacheTracks), sizeof(cacheTracks));
+      }
+
+      writeSection(file, clip.translationKeyframes.data(), sizeof(PackedVector) * clip.translationKeyframes.size());
+      writeSection(file, clip.rotationKeyframes.data(), sizeof(PackedQuaternion) * clip.rotationKeyframes.size());
+      writeSection(file, clip.scaleKeyframes.data(), sizeof(PackedVector) * clip.scaleKeyframes.size());
+      for (const std::vector<float>* times : { &clip.translationTimes, &clip.rotationTimes, &clip.scaleTimes })
+      {
+        writeSection(file, times->data(), sizeof(float) * times->size());
+      }
+    }
+
+    if (!file)
+    {
+      std::cerr << "Failed to write model cache " << temporaryFileName << "\n";
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporaryFileName, cacheFileName, error);
+  if (error)
+  {
+    std::cerr << "Failed to write model cache " << cacheFileName << ": " << error.message() << "\n";
+    std::filesystem::remove(temporaryFileName, error);
+    return false;
+  }
+
+  return true;
+}
+
+bool loadCache(const char* fileName, Model& model)
+{
+  POSER_PROFILE_SCOPE("Load cache");
+  const MappedFile file(getCacheFileName(fileName));
+  if (!file.data || file.size < sizeof(CacheHeader))
+  {
+    return false;
+  }
+
+  // Validate the header
+  const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(file.data);
+  if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+      header.boneCount > size_t(std::numeric_limits<uint16_t>::max()) + 1u ||
+      header.vertexFormat != static_cast<uint32_t>(chooseVertexFormat(header.boneCount)) ||
+      header.vertexSize != getPackedVertexSize(static_cast<VertexFormat>(header.vertexFormat)) ||
+      header.influenceCount == 0u || header.influenceCount > static_cast<uint32_t>(maxInfluenceCount) ||
+      header.indexFormat > static_cast<uint32_t>(IndexFormat::Index32) || header.clipCount == 0u)
+  {
+    return false;
+  }
+  const VertexFormat vertexFormat = static_cast<VertexFormat>(header.vertexFormat);
+  const IndexFormat indexFormat = static_cast<IndexFormat>(header.indexFormat);
+
+  // Locate the mesh and skeleton sections, all sections are 4-byte aligned
+  size_t offset = sizeof(CacheHeader);
+  const unsigned char* cachePackedVertices =
+    readSection<unsigned char>(file, offset, getPackedVertexSize(vertexFormat) * header.vertexCount);
+  const unsigned char* cacheIndices =
+    readSection<unsigned char>(file, offset, getIndexSize(indexFormat) * header.indexCount);
+  const Submesh* cacheSubmeshes = readSection<Submesh>(file, offset, header.submeshCount);
+  const CacheBone* cacheBones = readSection<CacheBone>(file, offset, header.boneCount);
+  if (!cachePackedVertices || !cacheIndices || !cacheSubmeshes || !cacheBones)
+  {
+    return false;
+  }
+
+  // Validate the submeshes, they follow each other through the indices and the vertices without leaving them and none
+  // has more influences than the mesh
+  for (uint32_t i = 0u; i < header.submeshCount; ++i)
+  {
+    const Submesh& submesh = cacheSubmeshes[i];
+    const uint32_t indexEnd = i + 1u < header.submeshCount ? cacheSubmeshes[i + 1u].firstIndex : header.indexCount;
+    const uint32_t previousBaseVertex = i > 0u ? cacheSubmeshes[i - 1u].baseVertex : 0u;
+    if (indexEnd > header.indexCount || submesh.firstIndex > indexEnd ||
+        submesh.indexCount != indexEnd - submesh.firstIndex || submesh.baseVertex < previousBaseVertex ||
+        submesh.baseVertex > header.vertexCount || submesh.influenceCount == 0u ||
+        submesh.influenceCount > header.influenceCount)
+    {
+      return false;
+    }
+  }
+  if (header.submeshCount > 0u ? cacheSubmeshes[0].firstIndex != 0u : header.indexCount != 0u)
+  {
+    return false;
+  }
+
+  // Validate the bones
+  for (uint32_t i = 0u; i < header.boneCount; ++i)
+  {
+    if (cacheBones[i].parentIndex >= static_cast<int32_t>(i))
+    {
+      return false;
+    }
+  }
+
+  // Gather the compressed clips straight out of the mapped file, they are only decoded once played
+  ClipLibrary clips;
+  for (uint32_t i = 0u; i < header.clipCount; ++i)
+  {
+    const CacheClipHeader* clipHeader = readSection<CacheClipHeader>(file, offset, 1u);
+    if (!clipHeader)
+    {
+      return false;
+    }
+
+    const char* name = readSection<char>(file, offset, clipHeader->nameLength);
+    const CacheTracks* cacheTracks = readSection<CacheTracks>(file, offset, header.boneCount);
+    const PackedVector* translations = readSection<PackedVector>(file, offset, clipHeader->translationKeyframeCount);
+    const PackedQuaternion* rotations = readSection<PackedQuaternion>(file, offset, clipHeader->rotationKeyframeCount);
+    const PackedVector* scales = readSection<PackedVector>(file, offset, clipHeader->scaleKeyframeCount);
+    const float* translationTimes = readSection<float>(file, offset, clipHeader->translationKeyframeCount);
+    const float* rotationTimes = readSection<float>(file, offset, clipHeader->rotationKeyframeCount);
+    const float* scaleTimes = readSection<float>(file, offset, clipHeader->scaleKeyframeCount);
+    if (!name || !cacheTracks || !translations || !rotations || !scales || !translationTimes || !rotationTimes ||
+        !scaleTimes)
+    {
+      return false;
+    }
+
+    // Validate the tracks
+    const auto isTrackValid = [](const Track& track, uint32_t keyframeCount)
+    { return track.first < keyframeCount && track.count > 0u && track.count <= keyframeCount - track.first; };
+    for (uint32_t j = 0u; j < header.boneCount; ++j)
+    {
+      const CacheTracks& tracks = cacheTracks[j];
+      if (!isTrackValid(tracks.translationTrack, clipHeader->translationKeyframeCount) ||
+          !isTrackValid(tracks.rotationTrack, clipHeader->rotationKeyframeCount) ||
+          !isTrackValid(tracks.scaleTrack, clipHeader->scaleKeyframeCount))
+      {
+        return false;
+      }
+    }
+
+    CompressedClip clip;
+    clip.translationKeyframes.assign(translations, translations + clipHeader->translationKeyframeCount);
+    clip.rotationKeyframes.assign(rotations, rotations + clipHeader->rotationKeyframeCount);
+    clip.scaleKeyframes.assign(scales, scales + clipHeader->scaleKeyframeCount);
+    clip.translationTimes.assign(translationTimes, translationTimes + clipHeader->translationKeyframeCount);
+    clip.rotationTimes.assign(rotationTimes, rotationTimes + clipHeader->rotationKeyframeCount);
+    clip.scaleTimes.assign(scaleTimes, scaleTimes + clipHeader->scaleKeyframeCount);
+    clip.duration = clipHeader->duration;
+
+    clip.translationTracks.resize(header.boneCount);
+    clip.rotationTracks.resize(header.boneCount);
+    clip.scaleTracks.resize(header.boneCount);
+    clip.translationRanges.resize(header.boneCount);
+    clip.scaleRanges.resize(header.boneCount);
+    for (uint32_t j = 0u; j < header.boneCount; ++j)
+    {
+      const CacheTracks& tracks = cacheTracks[j];
+      clip.translationTracks.at(j) = tracks.translationTrack;
+      clip.rotationTracks.at(j) = tracks.rotationTrack;
+      clip.scaleTracks.at(j) = tracks.scaleTrack;
+      clip.translationRanges.at(j) = tracks.translationRange;
+      clip.scaleRanges.at(j) = tracks.scaleRange;
+    }
+
+    clips.addClip(std::string(name, clipHeader->nameLength), std::move(clip));
+  }
+  if (offset != file.size)
+  {
+    return false;
+  }
+
+  // Copy the mesh and skeleton sections straight out of the mapped file, into a mesh of its own so that the model is
+  // left untouched until everything is validated
+  Mesh mesh;
+  mesh.influenceCount = static_cast<int>(header.influenceCount);
+  mesh.vertexFormat = vertexFormat;
+  if (vertexFormat == VertexFormat::Packed8)
+  {
+    const PackedVertex8* packedVertices = reinterpret_cast<const PackedVertex8*>(cachePackedVertices);
+    mesh.packedVertices8.assign(packedVertices, packedVertices + header.vertexCount);
+    unpackVertices(mesh.packedVertices8, mesh.vertices);
+  }
+  else
+  {
+    const PackedVertex16* packedVertices = reinterpret_cast<const PackedVertex16*>(cachePackedVertices);
+    mesh.packedVertices16.assign(packedVertices, packedVertices + header.vertexCount);
+    unpackVertices(mesh.packedVertices16, mesh.vertices);
+  }
+
+  // The index format depends on the largest draw range of the submeshes
+  mesh.submeshes.assign(cacheSubmeshes, cacheSubmeshes + header.submeshCount);
+  if (indexFormat != chooseIndexFormat(getMaxDrawRangeVertexCount(mesh)))
+  {
+    return false;
+  }
+
+  // The indices are also kept unpacked, widen them if they are packed
+  mesh.indexFormat = indexFormat;
+  if (indexFormat == IndexFormat::Index16)
+  {
+    const uint16_t* indices = reinterpret_cast<const uint16_t*>(cacheIndices);
+    mesh.packedIndices16.assign(indices, indices + header.indexCount);
+    mesh.indices.assign(indices, indices + header.indexCount);
+  }
+  else
+  {
+    const unsigned int* indices = reinterpret_cast<const unsigned int*>(cacheIndices);
+    mesh.indices.assign(indices, indices + header.indexCount);
+  }
+
+  // Validate the indices and the bone ids, each index addresses a vertex of its draw range, which also keeps the base
+  // vertices within the vertices, and each bone id one of the bones
+  for (const DrawRange& drawRange : getDrawRanges(mesh))
+  {
+    const auto indices = mesh.indices.begin() + drawRange.firstIndex;
+    if (std::any_of(indices, indices + drawRange.indexCount,
+                    [&drawRange](unsigned int index) { return index >= drawRange.vertexCount; }))
+    {
+      return false;
+    }
+  }
+  const auto isBoneIdValid = [&header](int boneId) { return boneId < static_cast<int>(header.boneCount); };
+  for (const Vertex& vertex : mesh.vertices)
+  {
+    if (!std::all_of(std::begin(vertex.boneIds), std::end(vertex.boneIds), isBoneIdValid))
+    {
+      return false;
+    }
+  }
+  model.mesh = std::move(mesh);
+
+  std::vector<Bone>& bones = model.skeleton.bones;
+  bones.resize(header.boneCount);
+  for (uint32_t i = 0u; i < header.boneCount; ++i)
+  {
+    bones.at(i).inverseBindMatrix = cacheBones[i].inverseBindMatrix;
+    bones.at(i).parent = cacheBones[i].parentIndex >= 0 ? cacheBones[i].parentIndex : -1;
+  }
+
+  model.clips = std::move(clips);
+
+  return true;
+}
+
+size_t readCache(const char* fileName)
+{
+  const MappedFile file(getCacheFileName(fileName));
+  uint32_t checksum = 0u;
+  for (size_t i = 0u; i + sizeof(uint32_t) <= file.size; i += sizeof(uint32_t))
+  {
+    uint32_t word;
+    std::memcpy(&word, file.data + i, sizeof(word));
+    checksum += word;
+  }
+
+  // Keeps the reads from being optimized away
+  volatile uint32_t sink = checksum;
+  static_cast<void>(sink);
+  return file.size;
+}
+
+} // namespace poser
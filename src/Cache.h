@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstddef>
+#include <filesystem>
+
+namespace poser
+{
+
+// Returns true if the cache exists and the source file is not newer than it, a missing source file is not an error
+bool isCacheUpToDate(const char* fileName);
+
+// Returns the name of the cache file next to the source file
+std::filesystem::path getCacheFileName(const char* fileName);
+
+// Writes the model to the cache file next to the source file
+bool saveCache(const char* fileName, const Model& model);
+
+// Returns false without touching the model if the cache is missing, outdated or malformed, the sections are validated
+// and copied out of the mapped file so that the model owns its data and the mapping closes before returning
+bool loadCache(const char* fileName, Model& model);
+
+// Maps the cache file and reads all of it without copying or validating anything, returns the number of bytes read or
+// 0 if the cache is missing, the lower bound of loading the cache for comparing the copies of loadCache against
+size_t readCache(const char* fileName);
+
+} // namespace poser
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace poser
+{
+
+// Keyframe track definition, a range of keyframes in one of the keyframe arrays of a clip
+struct Track
+{
+  uint32_t first = 0u, count = 0u;
+};
+
+// Animation clip definition, the keyframes of all bones are stored back to back and each bone has one track per array
+struct Clip
+{
+  std::vector<glm::vec3> translationKeyframes;
+  std::vector<glm::quat> rotationKeyframes;
+  std::vector<glm::vec3> scaleKeyframes;
+  std::vector<float> translationTimes, rotationTimes, scaleTimes;    // Keyframe times in seconds, ascending per track
+  std::vector<Track> translationTracks, rotationTracks, scaleTracks; // Indexed like the bones
+  float duration = 0.0f;                                             // In seconds
+};
+
+} // namespace poser
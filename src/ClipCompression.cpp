@@ -0,0 +1,509 @@
+#include "ClipCompression.h"
+
+#include "Pose.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/component_wise.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace poser
+{
+
+namespace
+{
+
+// Quantization constants
+constexpr float maxSmallestComponent = 0.70710678f; // 1 / sqrt(2), no other component can be larger than this
+constexpr int smallestComponentBits = 20;
+constexpr uint64_t smallestComponentMask = (uint64_t(1u) << smallestComponentBits) - 1u;
+constexpr float smallestComponentScale = static_cast<float>(smallestComponentMask); // Largest 20-bit value
+constexpr float vectorComponentScale = 65535.0f;                                     // Largest 16-bit value
+
+// Reduction constants
+constexpr float minShellDistance = 1.0e-3f; // Keeps the bounds of bones without extent finite, in model units
+constexpr uint32_t maxSegmentLength = 256u; // Keyframes a segment spans at most, bounds the checks of each segment
+
+// What reducing the keyframes of a bone must respect, the errors its tracks may introduce (in model units and radians)
+// and how far from the bone they are measured
+struct BoneBounds
+{
+  float positionError, angleError;
+  float shellDistance; // How far the descendants of the bone reach from it in model space
+  float parentScale;   // Largest scale of the parent bone in the bind pose
+};
+
+float getMaxScale(const glm::mat4& transform)
+{
+  return std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                    glm::length(glm::vec3(transform[2])) });
+}
+
+// Shares the error bounds out to the bones, the errors of all bones along a chain from a root to a leaf add up so each
+// bone gets an even share for the longest chain through it, and within a bone each animated track gets an even share
+std::vector<BoneBounds> getBoneBounds(const Skeleton& skeleton,
+                                      const ClipCompressionSettings& settings,
+                                      const Clip& clip)
+{
+  const std::vector<Bone>& bones = skeleton.bones;
+
+  std::vector<glm::mat4> bindTransforms(bones.size());
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    bindTransforms[i] = glm::inverse(toMat4(bones[i].inverseBindMatrix));
+  }
+
+  // Walk the bones leaves first to find how far their descendants reach and how long the chains below them are, then
+  // roots first to find how deep they are, leaves reach as far as they are long
+  std::vector<float> shellDistances(bones.size(), 0.0f);
+  std::vector<int> heights(bones.size(), 0), depths(bones.size(), 1);
+  for (size_t i = bones.size(); i-- > 0u;)
+  {
+    const int parent = bones[i].parent;
+    if (parent < 0)
+    {
+      continue;
+    }
+
+    const float length = glm::length(glm::vec3(bindTransforms[i][3] - bindTransforms[parent][3]));
+    shellDistances[i] = std::max(shellDistances[i], length);
+    shellDistances[parent] = std::max(shellDistances[parent], length + shellDistances[i]);
+    heights[parent] = std::max(heights[parent], heights[i] + 1);
+  }
+
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    if (bones[i].parent >= 0)
+    {
+      depths[i] = depths[bones[i].parent] + 1;
+    }
+  }
+
+  std::vector<BoneBounds> bounds(bones.size());
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    const int trackCount = std::max(static_cast<int>(clip.translationTracks.at(i).count > 1u) +
+                                      static_cast<int>(clip.rotationTracks.at(i).count > 1u) +
+                                      static_cast<int>(clip.scaleTracks.at(i).count > 1u),
+                                    1);
+    const float chainLength = static_cast<float>(depths[i] + heights[i]);
+
+    BoneBounds& boneBounds = bounds[i];
+    boneBounds.positionError = settings.maxPositionError / (chainLength * static_cast<float>(trackCount));
+    boneBounds.angleError = glm::radians(settings.maxAngleError) / chainLength;
+    boneBounds.shellDistance = std::max(shellDistances[i], minShellDistance);
+    boneBounds.parentScale = bones[i].parent >= 0 ? getMaxScale(bindTransforms[bones[i].parent]) : 1.0f;
+  }
+  return bounds;
+}
+
+// Normalized lerp along the shorter arc like the pose kernels interpolate rotations
+glm::quat interpolateRotation(const glm::quat& a, const glm::quat& b, float factor)
+{
+  const glm::quat target = glm::dot(a, b) < 0.0f ? -b : b;
+  return glm::normalize(a + (target - a) * factor);
+}
+
+// Angle between the orientations in radians, from the distance between the quaternions which unlike their dot product
+// stays precise for small angles
+float getAngle(const glm::quat& a, const glm::quat& b)
+{
+  const glm::vec4 difference = glm::vec4(a.x, a.y, a.z, a.w) * (glm::dot(a, b) < 0.0f ? -1.0f : 1.0f) -
+                               glm::vec4(b.x, b.y, b.z, b.w);
+  return 4.0f * std::asin(std::min(0.5f * glm::length(difference), 1.0f));
+}
+
+// Returns the orientation of the transform without its scale
+glm::quat getOrientation(const AffineTransform& transform)
+{
+  const glm::mat4 matrix = toMat4(transform);
+  return glm::quat_cast(glm::mat3(glm::normalize(glm::vec3(matrix[0])), glm::normalize(glm::vec3(matrix[1])),
+                                  glm::normalize(glm::vec3(matrix[2]))));
+}
+
+// Reduces the keyframes of a track onto the end of the reduced keyframes and times and points the track at them, the
+// closeness function returns true if a value reconstructs a keyframe closely enough
+template<typename Value, typename Interpolate, typename IsClose>
+void reduceTrack(const std::vector<Value>& keyframes,
+                 const std::vector<float>& times,
+                 Track& track,
+                 const Interpolate& interpolate,
+                 const IsClose& isClose,
+                 std::vector<Value>& reducedKeyframes,
+                 std::vector<float>& reducedTimes)
+{
+  const Value* trackKeyframes = keyframes.data() + track.first;
+  const float* trackTimes = times.data() + track.first;
+  const uint32_t count = track.count;
+  track.first = static_cast<uint32_t>(reducedKeyframes.size());
+
+  reducedKeyframes.push_back(trackKeyframes[0]);
+  reducedTimes.push_back(trackTimes[0]);
+
+  // A constant track only needs its first keyframe, which the pose holds for the whole clip
+  const bool constant = std::all_of(trackKeyframes + 1, trackKeyframes + count,
+                                    [&](const Value& value) { return isClose(value, trackKeyframes[0]); });
+  if (constant)
+  {
+    track.count = 1u;
+    return;
+  }
+
+  // Otherwise extend each segment from the last kept keyframe for as long as interpolating across it reconstructs all
+  // keyframes in between, moving the end of a segment changes the interpolation of all of them so each extension checks
+  // them again, capping the length of the segments keeps this linear in the keyframe count rather than quadratic
+  const auto segmentFits = [&](uint32_t from, uint32_t to)
+  {
+    for (uint32_t i = from + 1u; i < to; ++i)
+    {
+      const float factor = (trackTimes[i] - trackTimes[from]) / (trackTimes[to] - trackTimes[from]);
+      if (!isClose(interpolate(trackKeyframes[from], trackKeyframes[to], factor), trackKeyframes[i]))
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  uint32_t from = 0u;
+  while (from + 1u < count)
+  {
+    uint32_t to = from + 1u;
+    while (to + 1u < count && to - from < maxSegmentLength && segmentFits(from, to + 1u))
+    {
+      ++to;
+    }
+    reducedKeyframes.push_back(trackKeyframes[to]);
+    reducedTimes.push_back(trackTimes[to]);
+    from = to;
+  }
+  track.count = static_cast<uint32_t>(reducedKeyframes.size()) - track.first;
+}
+
+TrackRange getTrackRange(const std::vector<glm::vec3>& keyframes, const Track& track)
+{
+  glm::vec3 minimum = keyframes.at(track.first), maximum = minimum;
+  for (uint32_t i = track.first + 1u; i < track.first + track.count; ++i)
+  {
+    minimum = glm::min(minimum, keyframes[i]);
+    maximum = glm::max(maximum, keyframes[i]);
+  }
+  return { minimum, maximum - minimum };
+}
+
+PackedVector packVector(const glm::vec3& vector, const TrackRange& range)
+{
+  PackedVector packedVector;
+  for (int component = 0; component < 3; ++component)
+  {
+    const float extent = range.extent[component];
+    const float normalized = extent > 0.0f ? (vector[component] - range.minimum[component]) / extent : 0.0f;
+    packedVector.components[component] =
+      static_cast<uint16_t>(std::lround(std::clamp(normalized, 0.0f, 1.0f) * vectorComponentScale));
+  }
+  return packedVector;
+}
+
+glm::vec3 unpackVector(const PackedVector& packedVector, const TrackRange& range)
+{
+  const glm::vec3 normalized(packedVector.components[0], packedVector.components[1], packedVector.components[2]);
+  return range.minimum + range.extent * (normalized / vectorComponentScale);
+}
+
+PackedQuaternion packQuaternion(const glm::quat& rotation)
+{
+  // Drop the largest component, made positive by negating the quaternion (which represents the same rotation)
+  glm::vec4 components(rotation.x, rotation.y, rotation.z, rotation.w);
+  int largest = 0;
+  for (int i = 1; i < 4; ++i)
+  {
+    if (std::abs(components[i]) > std::abs(components[largest]))
+    {
+      largest = i;
+    }
+  }
+  if (components[largest] < 0.0f)
+  {
+    components = -components;
+  }
+
+  uint64_t packed = static_cast<uint64_t>(largest);
+  for (int i = 0, shift = 2; i < 4; ++i)
+  {
+    if (i == largest)
+    {
+      continue;
+    }
+
+    const float normalized = std::clamp(components[i] / maxSmallestComponent * 0.5f + 0.5f, 0.0f, 1.0f);
+    packed |= static_cast<uint64_t>(std::lround(normalized * smallestComponentScale)) << shift;
+    shift += smallestComponentBits;
+  }
+  return { { static_cast<uint32_t>(packed), static_cast<uint32_t>(packed >> 32u) } };
+}
+
+glm::quat unpackQuaternion(const PackedQuaternion& packedQuaternion)
+{
+  const uint64_t packed =
+    packedQuaternion.components[0] | (static_cast<uint64_t>(packedQuaternion.components[1]) << 32u);
+  const int largest = static_cast<int>(packed & 3u);
+
+  glm::vec4 components;
+  float squaredLength = 0.0f;
+  for (int i = 0, shift = 2; i < 4; ++i)
+  {
+    if (i == largest)
+    {
+      continue;
+    }
+
+    const float normalized = static_cast<float>((packed >> shift) & smallestComponentMask) / smallestComponentScale;
+    shift += smallestComponentBits;
+    components[i] = (normalized * 2.0f - 1.0f) * maxSmallestComponent;
+    squaredLength += components[i] * components[i];
+  }
+  components[largest] = std::sqrt(std::max(1.0f - squaredLength, 0.0f));
+  return glm::quat(components.w, components.x, components.y, components.z);
+}
+
+// Returns the largest distance between a translation or scale of the track and its quantized value
+glm::vec3 getVectorQuantizationError(const TrackRange& range)
+{
+  return range.extent * (0.5f / vectorComponentScale);
+}
+
+// Returns the largest angle between a rotation and its quantized value in radians, each of the three smallest
+// components is off by at most half a step, which the reconstructed largest one (at least 1 / 2) at most triples in
+// the squared distance between the quaternions
+float getRotationQuantizationAngle()
+{
+  const float componentError = maxSmallestComponent / smallestComponentScale;
+  return 4.0f * std::asin(std::sqrt(3.0f) * componentError);
+}
+
+} // namespace
+
+size_t reduceKeyframes(const Skeleton& skeleton, const ClipCompressionSettings& settings, Clip& clip)
+{
+  const size_t keyframeCount =
+    clip.translationKeyframes.size() + clip.rotationKeyframes.size() + clip.scaleKeyframes.size();
+  const std::vector<BoneBounds> bounds = getBoneBounds(skeleton, settings, clip);
+
+  const auto interpolateVector = [](const glm::vec3& a, const glm::vec3& b, float factor)
+  { return a + (b - a) * factor; };
+
+  Clip reducedClip;
+  reducedClip.translationTracks = clip.translationTracks;
+  reducedClip.rotationTracks = clip.rotationTracks;
+  reducedClip.scaleTracks = clip.scaleTracks;
+  reducedClip.duration = clip.duration;
+  const float rotationQuantizationAngle = getRotationQuantizationAngle();
+  for (size_t i = 0u; i < bounds.size(); ++i)
+  {
+    const BoneBounds& boneBounds = bounds[i];
+
+    // Quantizing the kept keyframes adds its own error on top of removing keyframes, so each track only gets what its
+    // share of the bounds leaves after the worst case quantization error in the range of the whole track (which holds
+    // the range of the reduced track), nothing but exact keyframes is removed once quantization alone uses it up
+    const TrackRange translationRange = getTrackRange(clip.translationKeyframes, clip.translationTracks.at(i));
+    const TrackRange scaleRange = getTrackRange(clip.scaleKeyframes, clip.scaleTracks.at(i));
+    const glm::vec3 smallestScale =
+      glm::max(glm::max(scaleRange.minimum, -(scaleRange.minimum + scaleRange.extent)), glm::vec3(minShellDistance));
+
+    const float translationError =
+      boneBounds.positionError - glm::length(getVectorQuantizationError(translationRange)) * boneBounds.parentScale;
+    const float rotationAngleError = boneBounds.angleError - rotationQuantizationAngle;
+    const float rotationPositionError =
+      boneBounds.positionError - 2.0f * boneBounds.shellDistance * std::sin(0.5f * rotationQuantizationAngle);
+    const float scaleError = boneBounds.positionError - glm::compMax(getVectorQuantizationError(scaleRange) /
+                                                                     smallestScale) * boneBounds.shellDistance;
+
+    // A translation error moves the bone and its descendants in the space of its parent
+    reduceTrack<glm::vec3>(
+      clip.translationKeyframes, clip.translationTimes, reducedClip.translationTracks.at(i), interpolateVector,
+      [&](const glm::vec3& a, const glm::vec3& b)
+      { return glm::length(a - b) * boneBounds.parentScale <= std::max(translationError, 0.0f); },
+      reducedClip.translationKeyframes, reducedClip.translationTimes);
+
+    // A rotation error turns the bone and swings its descendants around it
+    reduceTrack<glm::quat>(
+      clip.rotationKeyframes, clip.rotationTimes, reducedClip.rotationTracks.at(i), interpolateRotation,
+      [&](const glm::quat& a, const glm::quat& b)
+      {
+        const float angle = getAngle(a, b);
+        return angle <= std::max(rotationAngleError, 0.0f) &&
+               2.0f * boneBounds.shellDistance * std::sin(0.5f * angle) <= std::max(rotationPositionError, 0.0f);
+      },
+      reducedClip.rotationKeyframes, reducedClip.rotationTimes);
+
+    // A relative scale error moves the descendants along their distance from the bone
+    reduceTrack<glm::vec3>(
+      clip.scaleKeyframes, clip.scaleTimes, reducedClip.scaleTracks.at(i), interpolateVector,
+      [&](const glm::vec3& a, const glm::vec3& b)
+      {
+        const glm::vec3 relativeError = glm::abs(a - b) / glm::max(glm::abs(b), glm::vec3(minShellDistance));
+        return glm::compMax(relativeError) * boneBounds.shellDistance <= std::max(scaleError, 0.0f);
+      },
+      reducedClip.scaleKeyframes, reducedClip.scaleTimes);
+  }
+
+  clip = std::move(reducedClip);
+  return keyframeCount - clip.translationKeyframes.size() - clip.rotationKeyframes.size() - clip.scaleKeyframes.size();
+}
+
+void compressClip(const Clip& clip, CompressedClip& compressedClip)
+{
+  compressedClip.translationTimes = clip.translationTimes;
+  compressedClip.rotationTimes = clip.rotationTimes;
+  compressedClip.scaleTimes = clip.scaleTimes;
+  compressedClip.translationTracks = clip.translationTracks;
+  compressedClip.rotationTracks = clip.rotationTracks;
+  compressedClip.scaleTracks = clip.scaleTracks;
+  compressedClip.duration = clip.duration;
+
+  // Quantize the translations and scales in the range of their track
+  const size_t boneCount = clip.translationTracks.size();
+  compressedClip.translationRanges.resize(boneCount);
+  compressedClip.scaleRanges.resize(boneCount);
+  compressedClip.translationKeyframes.resize(clip.translationKeyframes.size());
+  compressedClip.scaleKeyframes.resize(clip.scaleKeyframes.size());
+  for (size_t i = 0u; i < boneCount; ++i)
+  {
+    const Track& translationTrack = clip.translationTracks.at(i);
+    const TrackRange translationRange = getTrackRange(clip.translationKeyframes, translationTrack);
+    compressedClip.translationRanges[i] = translationRange;
+    for (uint32_t j = translationTrack.first; j < translationTrack.first + translationTrack.count; ++j)
+    {
+      compressedClip.translationKeyframes[j] = packVector(clip.translationKeyframes[j], translationRange);
+    }
+
+    const Track& scaleTrack = clip.scaleTracks.at(i);
+    const TrackRange scaleRange = getTrackRange(clip.scaleKeyframes, scaleTrack);
+    compressedClip.scaleRanges[i] = scaleRange;
+    for (uint32_t j = scaleTrack.first; j < scaleTrack.first + scaleTrack.count; ++j)
+    {
+      compressedClip.scaleKeyframes[j] = packVector(clip.scaleKeyframes[j], scaleRange);
+    }
+  }
+
+  compressedClip.rotationKeyframes.resize(clip.rotationKeyframes.size());
+  std::transform(clip.rotationKeyframes.begin(), clip.rotationKeyframes.end(),
+                 compressedClip.rotationKeyframes.begin(), packQuaternion);
+}
+
+void decompressClip(const CompressedClip& compressedClip, Clip& clip)
+{
+  clip.translationTimes = compressedClip.translationTimes;
+  clip.rotationTimes = compressedClip.rotationTimes;
+  clip.scaleTimes = compressedClip.scaleTimes;
+  clip.translationTracks = compressedClip.translationTracks;
+  clip.rotationTracks = compressedClip.rotationTracks;
+  clip.scaleTracks = compressedClip.scaleTracks;
+  clip.duration = compressedClip.duration;
+
+  clip.translationKeyframes.resize(compressedClip.translationKeyframes.size());
+  clip.scaleKeyframes.resize(compressedClip.scaleKeyframes.size());
+  for (size_t i = 0u; i < compressedClip.translationTracks.size(); ++i)
+  {
+    const Track& translationTrack = compressedClip.translationTracks[i];
+    const TrackRange& translationRange = compressedClip.translationRanges.at(i);
+    for (uint32_t j = translationTrack.first; j < translationTrack.first + translationTrack.count; ++j)
+    {
+      clip.translationKeyframes[j] = unpackVector(compressedClip.translationKeyframes[j], translationRange);
+    }
+
+    const Track& scaleTrack = compressedClip.scaleTracks[i];
+    const TrackRange& scaleRange = compressedClip.scaleRanges.at(i);
+    for (uint32_t j = scaleTrack.first; j < scaleTrack.first + scaleTrack.count; ++j)
+    {
+      clip.scaleKeyframes[j] = unpackVector(compressedClip.scaleKeyframes[j], scaleRange);
+    }
+  }
+
+  clip.rotationKeyframes.resize(compressedClip.rotationKeyframes.size());
+  std::transform(compressedClip.rotationKeyframes.begin(), compressedClip.rotationKeyframes.end(),
+                 clip.rotationKeyframes.begin(), unpackQuaternion);
+}
+
+void compressClipInPlace(const Skeleton& skeleton, const ClipCompressionSettings& settings, Clip& clip)
+{
+  reduceKeyframes(skeleton, settings, clip);
+  CompressedClip compressedClip;
+  compressClip(clip, compressedClip);
+  decompressClip(compressedClip, clip);
+}
+
+ClipError measureClipError(const Skeleton& skeleton, const Clip& reference, const Clip& clip)
+{
+  const std::vector<Bone>& bones = skeleton.bones;
+  const std::vector<BoneBounds> bounds = getBoneBounds(skeleton, ClipCompressionSettings(), reference);
+
+  // Measure at the bone and at points as far out as its descendants reach along each of its axes, in bone space
+  std::vector<float> shellDistances(bones.size());
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    shellDistances[i] = bounds[i].shellDistance / getMaxScale(glm::inverse(toMat4(bones[i].inverseBindMatrix)));
+  }
+
+  // Sample at every keyframe time within the clip, the time at the very end wraps around to the start
+  std::vector<float> times;
+  for (const std::vector<float>* trackTimes :
+       { &reference.translationTimes, &reference.rotationTimes, &reference.scaleTimes })
+  {
+    times.insert(times.end(), trackTimes->begin(), trackTimes->end());
+  }
+  std::sort(times.begin(), times.end());
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+
+  Pose referencePose, pose;
+  referencePose.resize(bones.size());
+  pose.resize(bones.size());
+
+  ClipError error = { 0.0f, 0.0f };
+  for (const float time : times)
+  {
+    if (time < 0.0f || (time >= reference.duration && reference.duration > 0.0f))
+    {
+      continue;
+    }
+
+    updatePose(skeleton, reference, time, referencePose);
+    updatePose(skeleton, clip, time, pose);
+    for (size_t i = 0u; i < bones.size(); ++i)
+    {
+      const AffineTransform& a = referencePose.posedTransforms[i];
+      const AffineTransform& b = pose.posedTransforms[i];
+      error.position = std::max(error.position, glm::length(transformPoint(a, glm::vec3(0.0f)) -
+                                                            transformPoint(b, glm::vec3(0.0f))));
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        glm::vec3 point(0.0f);
+        point[axis] = shellDistances[i];
+        error.position = std::max(error.position, glm::length(transformPoint(a, point) - transformPoint(b, point)));
+      }
+      error.angle = std::max(error.angle, glm::degrees(getAngle(getOrientation(a), getOrientation(b))));
+    }
+  }
+  return error;
+}
+
+size_t getKeyframeMemory(const Clip& clip)
+{
+  const size_t keyframeCount =
+    clip.translationKeyframes.size() + clip.rotationKeyframes.size() + clip.scaleKeyframes.size();
+  return sizeof(glm::vec3) * clip.translationKeyframes.size() + sizeof(glm::quat) * clip.rotationKeyframes.size() +
+         sizeof(glm::vec3) * clip.scaleKeyframes.size() + sizeof(float) * keyframeCount;
+}
+
+size_t getKeyframeMemory(const CompressedClip& compressedClip)
+{
+  const size_t keyframeCount = compressedClip.translationKeyframes.size() +
+                               compressedClip.rotationKeyframes.size() + compressedClip.scaleKeyframes.size();
+  return sizeof(PackedVector) * compressedClip.translationKeyframes.size() +
+         sizeof(PackedQuaternion) * compressedClip.rotationKeyframes.size() +
+         sizeof(PackedVector) * compressedClip.scaleKeyframes.size() + sizeof(float) * keyframeCount +
+         sizeof(TrackRange) * (compressedClip.translationRanges.size() + compressedClip.scaleRanges.size());
+}
+
+} // namespace poser
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Clip.h"
+#include "Skeleton.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace poser
+{
+
+// Error bounds for removing keyframes, both are measured in model space through the hierarchy so the errors of the
+// bones along a chain share them
+struct ClipCompressionSettings
+{
+  float maxPositionError = 0.01f; // In model units, a tenth of a millimetre for models in centimetres like most FBX
+  float maxAngleError = 0.1f;     // In degrees
+};
+
+// Quantized rotation keyframe, the three smallest components of the quaternion (with the largest one made positive) as
+// 20-bit unsigned normalized values in [-1 / sqrt(2), 1 / sqrt(2)] above the two-bit index of the dropped largest
+// component, split across two words low bits first, 15 bits would already miss an error bound of a tenth of a degree
+// across chains of a few dozen bones
+struct PackedQuaternion
+{
+  uint32_t components[2];
+};
+
+// Quantized translation or scale keyframe, 16-bit unsigned normalized values in the range of the track
+struct PackedVector
+{
+  uint16_t components[3];
+};
+
+// Range of the keyframes of a translation or scale track
+struct TrackRange
+{
+  glm::vec3 minimum = glm::vec3(0.0f), extent = glm::vec3(0.0f);
+};
+
+// Compressed clip definition, the clip with its keyframes quantized, tracks and times as in the clip
+struct CompressedClip
+{
+  std::vector<PackedVector> translationKeyframes;
+  std::vector<PackedQuaternion> rotationKeyframes;
+  std::vector<PackedVector> scaleKeyframes;
+  std::vector<float> translationTimes, rotationTimes, scaleTimes;
+  std::vector<Track> translationTracks, rotationTracks, scaleTracks;
+  std::vector<TrackRange> translationRanges, scaleRanges; // Indexed like the bones
+  float duration = 0.0f;
+};
+
+// Largest error of a clip against a reference clip in model space
+struct ClipError
+{
+  float position; // Of the bones and points around them as far out as their descendants reach, in model units
+  float angle;    // Of the bone orientations, in degrees
+};
+
+// Collapses constant tracks into a single keyframe and removes the keyframes that interpolating their neighbours
+// reconstructs within what the error bounds leave after the worst case error of quantizing the keyframes, returns the
+// number of keyframes removed
+size_t reduceKeyframes(const Skeleton& skeleton, const ClipCompressionSettings& settings, Clip& clip);
+
+// Quantizes the keyframes of the clip
+void compressClip(const Clip& clip, CompressedClip& compressedClip);
+
+void decompressClip(const CompressedClip& compressedClip, Clip& clip);
+
+// Reduces the keyframes of the clip and quantizes them, leaving the clip as decompressing it would restore it
+void compressClipInPlace(const Skeleton& skeleton, const ClipCompressionSettings& settings, Clip& clip);
+
+// Samples both clips at every keyframe time of the reference clip and compares the posed skeletons
+ClipError measureClipError(const Skeleton& skeleton, const Clip& reference, const Clip& clip);
+
+// Returns the size in bytes of the keyframes (including their times) of the clip or compressed clip
+size_t getKeyframeMemory(const Clip& clip);
+size_t getKeyframeMemory(const CompressedClip& compressedClip);
+
+} // namespace poser
@@ -0,0 +1,106 @@
+#include "ClipLibrary.h"
+
+#include "Profiler.h"
+
+#include <utility>
+
+namespace poser
+{
+
+void ClipLibrary::addClip(std::string name, Clip clip)
+{
+  std::unique_ptr<Entry>& entry = entries.emplace_back(std::make_unique<Entry>());
+  entry->name = std::move(name);
+  entry->duration = clip.duration;
+  entry->clip = std::move(clip);
+
+  // The clip is already decoded, so mark the decoding as done
+  std::call_once(entry->decodeFlag, [] {});
+  entry->decoded = true;
+}
+
+void ClipLibrary::addClip(std::string name, CompressedClip compressedClip)
+{
+  std::unique_ptr<Entry>& entry = entries.emplace_back(std::make_unique<Entry>());
+  entry->name = std::move(name);
+  entry->duration = compressedClip.duration;
+  entry->compressedClip = std::move(compressedClip);
+
+  // The clip is already compressed, so mark the compression as done
+  std::call_once(entry->compressFlag, [] {});
+}
+
+size_t ClipLibrary::getClipCount() const
+{
+  return entries.size();
+}
+
+const std::string& ClipLibrary::getClipName(size_t index) const
+{
+  return entries.at(index)->name;
+}
+
+float ClipLibrary::getClipDuration(size_t index) const
+{
+  return entries.at(index)->duration;
+}
+
+int ClipLibrary::findClip(std::string_view name) const
+{
+  for (size_t i = 0u; i < entries.size(); ++i)
+  {
+    if (entries[i]->name == name)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+const Clip& ClipLibrary::getClip(size_t index) const
+{
+  const Entry& entry = *entries.at(index);
+  std::call_once(entry.decodeFlag,
+                 [&entry]
+                 {
+                   POSER_PROFILE_SCOPE("Decode clip");
+                   decompressClip(entry.compressedClip, entry.clip);
+                   entry.decoded = true;
+                 });
+  return entry.clip;
+}
+
+const CompressedClip& ClipLibrary::getCompressedClip(size_t index) const
+{
+  const Entry& entry = *entries.at(index);
+  std::call_once(entry.compressFlag, [&entry] { compressClip(entry.clip, entry.compressedClip); });
+  return entry.compressedClip;
+}
+
+size_t ClipLibrary::getDecodedClipCount() const
+{
+  size_t count = 0u;
+  for (const std::unique_ptr<Entry>& entry : entries)
+  {
+    count += entry->decoded ? 1u : 0u;
+  }
+  return count;
+}
+
+void compressClips(const Skeleton& skeleton, const ClipCompressionSettings& settings, ClipLibrary& clips)
+{
+  POSER_PROFILE_SCOPE("Compress clips");
+  ClipLibrary compressedClips;
+  for (size_t i = 0u; i < clips.getClipCount(); ++i)
+  {
+    Clip clip = clips.getClip(i);
+    reduceKeyframes(skeleton, settings, clip);
+
+    CompressedClip compressedClip;
+    compressClip(clip, compressedClip);
+    compressedClips.addClip(clips.getClipName(i), std::move(compressedClip));
+  }
+  clips = std::move(compressedClips);
+}
+
+} // namespace poser
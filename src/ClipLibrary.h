@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Clip.h"
+#include "ClipCompression.h"
+#include "Skeleton.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace poser
+{
+
+// Clip library definition, the named clips of a model with their tracks indexed like the bones of its skeleton, clips
+// are kept in whichever form they were added in and converted to the other form on first use, so that loading many
+// compressed clips only decodes those that are actually played, a played clip keeps its compressed form on purpose
+// since saving the cache needs it and quantizing the decoded keyframes again would shift the track ranges and with them
+// the keyframes, the compressed form takes about 60% of the memory of the decoded one (both hold the same times)
+class ClipLibrary
+{
+public:
+  // Adds a decoded clip, for example an imported one
+  void addClip(std::string name, Clip clip);
+
+  // Adds a compressed clip, which is decoded when it is first played
+  void addClip(std::string name, CompressedClip compressedClip);
+
+  size_t getClipCount() const;
+  const std::string& getClipName(size_t index) const;
+  float getClipDuration(size_t index) const; // In seconds, without decoding the clip
+
+  // Returns the index of the first clip with the name or -1 if there is no such clip
+  int findClip(std::string_view name) const;
+
+  // Returns the decoded clip, decoding it if this is its first use, safe to call from several threads at once
+  const Clip& getClip(size_t index) const;
+
+  // Returns the compressed clip, quantizing the decoded clip if this is its first use, safe to call from several
+  // threads at once
+  const CompressedClip& getCompressedClip(size_t index) const;
+
+  // Returns the number of clips that are held decoded
+  size_t getDecodedClipCount() const;
+
+private:
+  struct Entry
+  {
+    std::string name;
+    float duration;
+    mutable std::once_flag decodeFlag, compressFlag;
+    mutable std::atomic<bool> decoded = false;
+    mutable Clip clip;
+    mutable CompressedClip compressedClip;
+  };
+
+  std::vector<std::unique_ptr<Entry>> entries; // Entries stay in place since once flags cannot move
+};
+
+// Reduces the keyframes of every clip in the library and keeps only their compressed form, so that this run plays the
+// same keyframes as the runs loading the clips from the cache and decodes them just as lazily
+void compressClips(const Skeleton& skeleton, const ClipCompressionSettings& settings, ClipLibrary& clips);
+
+} // namespace poser
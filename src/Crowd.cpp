@@ -0,0 +1,128 @@
+#include "Crowd.h"
+
+#include "Profiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace poser
+{
+
+namespace
+{
+
+// Crowd constants
+constexpr float crowdSpacing = 2.0f;  // Distance between neighboring instances on the ground plane
+constexpr size_t tasksPerThread = 4u; // Splitting the instances finer than the threads lets idle threads steal work
+
+} // namespace
+
+std::vector<Instance> createInstances(const Model& model, int count)
+{
+  const int columnCount = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+  const float center = static_cast<float>(columnCount - 1) * crowdSpacing * 0.5f;
+
+  std::vector<Instance> instances(static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i)
+  {
+    Instance& instance = instances.at(i);
+    instance.position = glm::vec3(static_cast<float>(i % columnCount) * crowdSpacing - center, 0.0f,
+                                  static_cast<float>(i / columnCount) * crowdSpacing - center);
+    instance.timeOffset =
+      i > 0 ? glm::fract(static_cast<float>(i) * glm::golden_ratio<float>()) * model.clips.getClipDuration(0u) : 0.0f;
+    instance.clipIndex = 0u;
+    instance.pose.resize(model.skeleton.bones.size());
+  }
+  return instances;
+}
+
+void setClip(Instance& instance, size_t clipIndex)
+{
+  // The keyframe cursors point into the tracks of the previous clip
+  instance.clipIndex = clipIndex;
+  std::fill(instance.pose.cursors.begin(), instance.pose.cursors.end(), Cursor());
+}
+
+AnimationLayer& addLayer(Instance& instance, size_t clipIndex, BlendMode blendMode, const BoneMask* mask)
+{
+  AnimationLayer& layer = instance.layers.emplace_back();
+  layer.clipIndex = clipIndex;
+  layer.timeOffset = instance.timeOffset;
+  layer.weight = 0.0f;
+  layer.blendMode = blendMode;
+  layer.mask = mask;
+  layer.cursors.assign(instance.pose.cursors.size(), Cursor());
+  return layer;
+}
+
+void promoteLayer(Instance& instance, size_t layerIndex)
+{
+  AnimationLayer& layer = instance.layers.at(layerIndex);
+  instance.clipIndex = layer.clipIndex;
+  instance.timeOffset = layer.timeOffset;
+  instance.pose.cursors = std::move(layer.cursors);
+  instance.layers.erase(instance.layers.begin(), instance.layers.begin() + layerIndex + 1);
+}
+
+void updateAnimation(const Model& model, Instance& instance, double time, SkinningMode skinningMode)
+{
+  Pose& pose = instance.pose;
+  pose.keepPreviousBoneTransforms();
+  sampleClip(model.clips.getClip(instance.clipIndex), time + instance.timeOffset, pose.cursors, pose.localPose);
+
+  // Blend each layer over the local pose, sampled into a scratch local pose that only needs resizing for new skeletons
+  static thread_local LocalPose layerPose;
+  for (AnimationLayer& layer : instance.layers)
+  {
+    if (layer.weight <= 0.0f)
+    {
+      continue;
+    }
+
+    if (layerPose.translationX.size() != pose.localPose.translationX.size())
+    {
+      layerPose.resize(model.skeleton.bones.size());
+    }
+
+    sampleClip(model.clips.getClip(layer.clipIndex), time + layer.timeOffset, layer.cursors, layerPose);
+    if (layer.blendMode == BlendMode::Additive)
+    {
+      addLocalPose(pose.localPose, layerPose, layer.weight, layer.mask, pose.localPose);
+    }
+    else
+    {
+      blendLocalPoses(pose.localPose, layerPose, layer.weight, layer.mask, pose.localPose);
+    }
+  }
+
+  updateTransforms(model.skeleton, pose);
+  if (skinningMode == SkinningMode::DualQuaternion)
+  {
+    std::transform(pose.boneTransforms.begin(), pose.boneTransforms.end(), pose.boneDualQuaternions.begin(),
+                   [](const AffineTransform& transform) { return toDualQuaternion(transform); });
+  }
+}
+
+void updateAnimations(ThreadPool& threadPool,
+                      const Model& model,
+                      std::vector<Instance>& instances,
+                      double time,
+                      SkinningMode skinningMode)
+{
+  POSER_PROFILE_SCOPE("Update animations");
+  const size_t chunkSize = instances.size() / (threadPool.getThreadCount() * tasksPerThread);
+  threadPool.parallelFor(instances.size(), chunkSize,
+                         [&model, &instances, time, skinningMode](size_t begin, size_t end)
+                         {
+                           POSER_PROFILE_SCOPE("Update animation chunk");
+                           for (size_t i = begin; i < end; ++i)
+                           {
+                             updateAnimation(model, instances[i], time, skinningMode);
+                           }
+                         });
+}
+
+} // namespace poser
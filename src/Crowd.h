@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Blend.h"
+#include "Model.h"
+#include "Pose.h"
+#include "Skinning.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace poser
+{
+
+// Animation layer definition, another clip blended over the clip of an instance and the layers below it, for example
+// to crossfade to a new clip by raising the weight of an override layer from zero to one
+struct AnimationLayer
+{
+  size_t clipIndex; // Into the clip library of the model
+  float timeOffset; // In seconds
+  float weight;     // From zero (no effect) to one
+  BlendMode blendMode;
+  const BoneMask* mask;        // Or null to blend all bones alike, must outlive the layer
+  std::vector<Cursor> cursors; // Indexed like the bones
+};
+
+// Animated instance definition, all instances share the skeleton and the clip library but play their own clip at their
+// own time offset, optionally with layers blended over it
+struct Instance
+{
+  glm::vec3 position;
+  float timeOffset;                   // In seconds
+  size_t clipIndex;                   // Into the clip library of the model
+  std::vector<AnimationLayer> layers; // Applied in order over the clip
+  Pose pose;
+};
+
+// Creates the instances for the model in a square grid centered on the origin, all playing the first clip with their
+// time offsets spread evenly but unordered across it
+std::vector<Instance> createInstances(const Model& model, int count);
+
+// Switches the instance to another clip of the clip library, which is decoded when the instance is next updated if
+// no instance played it before
+void setClip(Instance& instance, size_t clipIndex);
+
+// Adds a layer with zero weight playing the clip at the time offset of the instance on top of the layers of the
+// instance and returns it
+AnimationLayer& addLayer(Instance& instance, size_t clipIndex, BlendMode blendMode, const BoneMask* mask);
+
+// Makes the clip of the layer (which should be an override layer without a mask at full weight) the clip of the
+// instance and removes the layer together with the layers below it, which it hides completely
+void promoteLayer(Instance& instance, size_t layerIndex);
+
+// Poses the bones of the instance at the time in seconds, blending its layers over its clip in local space, and
+// converts the bone transforms to the form the skinning mode blends
+void updateAnimation(const Model& model, Instance& instance, double time, SkinningMode skinningMode);
+
+// Poses all instances at the time in seconds, spread across the threads of the thread pool
+void updateAnimations(ThreadPool& threadPool,
+                      const Model& model,
+                      std::vector<Instance>& instances,
+                      double time,
+                      SkinningMode skinningMode);
+
+} // namespace poser
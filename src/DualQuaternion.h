@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Affine.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace poser
+{
+
+// Dual quaternion definition, a rotation followed by a translation in eight floats, the real part is the rotation and
+// the dual part is half the translation times the rotation, both stored with the vector part in x, y, z and the scalar
+// part in w
+struct DualQuaternion
+{
+  glm::vec4 real, dual;
+};
+
+// Drops the scale and shear of the transform, which dual quaternions cannot represent
+inline DualQuaternion toDualQuaternion(const AffineTransform& transform)
+{
+  const glm::mat3 rotation = glm::transpose(
+    glm::mat3(glm::vec3(transform.rows[0]), glm::vec3(transform.rows[1]), glm::vec3(transform.rows[2])));
+  const glm::quat real = glm::normalize(glm::quat_cast(rotation));
+  const glm::quat translation(0.0f, transform.rows[0].w, transform.rows[1].w, transform.rows[2].w);
+  const glm::quat dual = 0.5f * (translation * real);
+  return { glm::vec4(real.x, real.y, real.z, real.w), glm::vec4(dual.x, dual.y, dual.z, dual.w) };
+}
+
+// Rotates the vector by the real part, which must be normalized
+inline glm::vec3 transformVector(const DualQuaternion& transform, const glm::vec3& vector)
+{
+  const glm::vec3 axis(transform.real);
+  return vector + 2.0f * glm::cross(axis, glm::cross(axis, vector) + transform.real.w * vector);
+}
+
+// Rotates the point by the real part, which must be normalized, and then translates it by the dual part
+inline glm::vec3 transformPoint(const DualQuaternion& transform, const glm::vec3& point)
+{
+  const glm::vec3 axis(transform.real), dualAxis(transform.dual);
+  const glm::vec3 translation =
+    2.0f * (transform.real.w * dualAxis - transform.dual.w * axis + glm::cross(axis, dualAxis));
+  return transformVector(transform, point) + translation;
+}
+
+} // namespace poser
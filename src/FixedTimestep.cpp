@@ -0,0 +1,45 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+namespace poser
+{
+
+FixedTimestep::FixedTimestep(double stepRate) : stepDuration(1.0 / stepRate)
+{
+}
+
+void FixedTimestep::advance(double time, int maxStepCount)
+{
+  if (previousTime >= 0.0)
+  {
+    accumulatedTime = std::min(accumulatedTime + (time - previousTime), stepDuration * maxStepCount);
+  }
+  previousTime = time;
+}
+
+bool FixedTimestep::step(double& stepTime)
+{
+  if (accumulatedTime < stepDuration)
+  {
+    return false;
+  }
+
+  // Times are multiples of the step duration rather than sums of it, so that they do not drift
+  accumulatedTime -= stepDuration;
+  ++stepIndex;
+  stepTime = static_cast<double>(stepIndex) * stepDuration;
+  return true;
+}
+
+double FixedTimestep::getStepDuration() const
+{
+  return stepDuration;
+}
+
+float FixedTimestep::getInterpolationFactor() const
+{
+  return std::min(static_cast<float>(accumulatedTime / stepDuration), 1.0f);
+}
+
+} // namespace poser
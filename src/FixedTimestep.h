@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace poser
+{
+
+// Fixed timestep definition, splits the real time that passes into simulation steps of constant length so that the
+// simulation advances at the same rate however often frames are rendered, and tracks how far the real time has moved
+// past the last step so that frames can interpolate between the last two steps
+class FixedTimestep
+{
+public:
+  explicit FixedTimestep(double stepRate); // In steps per second
+
+  // Adds the real time passed since the previous call (or since the first call, which only sets the start time), at
+  // most enough for the maximum step count so that a slow frame does not make the following frames slower still
+  void advance(double time, int maxStepCount); // In seconds
+
+  // Consumes the next step and returns true if it is due, with its simulation time in seconds
+  bool step(double& stepTime);
+
+  double getStepDuration() const; // In seconds
+
+  // Returns how far the real time is past the last step towards the next step, from zero to one once all due steps
+  // were consumed
+  float getInterpolationFactor() const;
+
+private:
+  double stepDuration;
+  double accumulatedTime = 0.0; // Real time not consumed by steps yet
+  double previousTime = -1.0;   // Negative before the first call to advance()
+  int64_t stepIndex = 0;        // Of the last step
+};
+
+} // namespace poser
@@ -0,0 +1,472 @@
+#include "Import.h"
+
+#include "MeshOptimization.h"
+#include "Profiler.h"
+#include "Synthetic.h"
+#include "VertexPacking.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace poser
+{
+
+namespace
+{
+
+// Animation constants
+constexpr double defaultTicksPerSecond = 25.0; // Used by Assimp for files that do not specify a tick rate
+constexpr char restPoseClipName[] = "Rest pose"; // Of the clip that models without animations get
+
+// Rest pose of a bone, the transform of its node relative to its parent node split into its components
+struct RestTransform
+{
+  glm::vec3 translation = glm::vec3(0.0f);
+  glm::quat rotation = glm::identity<glm::quat>();
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+AffineTransform assimpToAffineTransform(const aiMatrix4x4& matrix)
+{
+  // Both are row-major, so the upper three rows can be copied as they are
+  return { { glm::make_vec4(&matrix.a1), glm::make_vec4(&matrix.b1), glm::make_vec4(&matrix.c1) } };
+}
+
+std::string_view assimpToStringView(const aiString& string)
+{
+  return std::string_view(string.data, string.length);
+}
+
+// Sets the parent and the rest pose of each bone (as an unsorted bone index) and appends the bones in depth-first order
+// to the bone order
+void loadSkeletonNode(const BoneIndexMap& boneIndices,
+                      const aiNode* node,
+                      int parent,
+                      Skeleton& skeleton,
+                      std::vector<RestTransform>& restTransforms,
+                      std::vector<int>& boneOrder)
+{
+  const int boneIndex = findNamedBone(boneIndices, node->mName);
+  if (boneIndex >= 0)
+  {
+    skeleton.bones.at(boneIndex).parent = parent;
+    boneOrder.push_back(boneIndex);
+    parent = boneIndex;
+
+    aiVector3D scale, translation;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scale, rotation, translation);
+    restTransforms.at(boneIndex) = { glm::vec3(translation.x, translation.y, translation.z),
+                                     glm::quat(rotation.w, rotation.x, rotation.y, rotation.z),
+                                     glm::vec3(scale.x, scale.y, scale.z) };
+  }
+
+  // Process the children of this node recursively
+  for (unsigned int i = 0u; i < node->mNumChildren; ++i)
+  {
+    loadSkeletonNode(boneIndices, node->mChildren[i], parent, skeleton, restTransforms, boneOrder);
+  }
+}
+
+// Converts the animation into the clip, whose tracks are indexed like the (unsorted) bones, channels animating other
+// nodes are skipped
+void loadClip(const BoneIndexMap& boneIndices, const aiAnimation* animation, Clip& clip)
+{
+  // Keyframe times are stored in ticks, Assimp leaves the tick rate at zero if the file does not specify it
+  const double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : defaultTicksPerSecond;
+  clip.duration = static_cast<float>(animation->mDuration / ticksPerSecond);
+
+  // Load the keyframes for each bone
+  for (unsigned int i = 0u; i < animation->mNumChannels; ++i)
+  {
+    const aiNodeAnim* channel = animation->mChannels[i];
+
+    const int boneIndex = findNamedBone(boneIndices, channel->mNodeName);
+    if (boneIndex < 0)
+    {
+      continue;
+    }
+
+    // Translation keyframes
+    {
+      clip.translationTracks.at(boneIndex) = { static_cast<uint32_t>(clip.translationKeyframes.size()),
+                                               channel->mNumPositionKeys };
+      for (unsigned int j = 0u; j < channel->mNumPositionKeys; ++j)
+      {
+        const aiVector3D& translation = channel->mPositionKeys[j].mValue;
+        clip.translationKeyframes.push_back(glm::vec3(translation.x, translation.y, translation.z));
+        clip.translationTimes.push_back(static_cast<float>(channel->mPositionKeys[j].mTime / ticksPerSecond));
+      }
+    }
+
+    // Rotation keyframes
+    {
+      clip.rotationTracks.at(boneIndex) = { static_cast<uint32_t>(clip.rotationKeyframes.size()),
+                                            channel->mNumRotationKeys };
+      for (unsigned int j = 0u; j < channel->mNumRotationKeys; ++j)
+      {
+        const aiQuaternion& rotation = channel->mRotationKeys[j].mValue;
+        clip.rotationKeyframes.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+        clip.rotationTimes.push_back(static_cast<float>(channel->mRotationKeys[j].mTime / ticksPerSecond));
+      }
+    }
+
+    // Scale keyframes
+    {
+      clip.scaleTracks.at(boneIndex) = { static_cast<uint32_t>(clip.scaleKeyframes.size()),
+                                         channel->mNumScalingKeys };
+      for (unsigned int j = 0u; j < channel->mNumScalingKeys; ++j)
+      {
+        const aiVector3D& scale = channel->mScalingKeys[j].mValue;
+        clip.scaleKeyframes.push_back(glm::vec3(scale.x, scale.y, scale.z));
+        clip.scaleTimes.push_back(static_cast<float>(channel->mScalingKeys[j].mTime / ticksPerSecond));
+      }
+    }
+  }
+}
+
+// Gives each empty track a single keyframe holding the rest pose of its bone, like Assimp does for nodes that an
+// animation does not animate, so that sampling never has to special case empty tracks
+void addMissingKeyframes(const std::vector<RestTransform>& restTransforms, Clip& clip)
+{
+  for (size_t i = 0u; i < restTransforms.size(); ++i)
+  {
+    const RestTransform& restTransform = restTransforms.at(i);
+
+    if (clip.translationTracks.at(i).count == 0u)
+    {
+      clip.translationTracks.at(i) = { static_cast<uint32_t>(clip.translationKeyframes.size()), 1u };
+      clip.translationKeyframes.push_back(restTransform.translation);
+      clip.translationTimes.push_back(0.0f);
+    }
+
+    if (clip.rotationTracks.at(i).count == 0u)
+    {
+      clip.rotationTracks.at(i) = { static_cast<uint32_t>(clip.rotationKeyframes.size()), 1u };
+      clip.rotationKeyframes.push_back(restTransform.rotation);
+      clip.rotationTimes.push_back(0.0f);
+    }
+
+    if (clip.scaleTracks.at(i).count == 0u)
+    {
+      clip.scaleTracks.at(i) = { static_cast<uint32_t>(clip.scaleKeyframes.size()), 1u };
+      clip.scaleKeyframes.push_back(restTransform.scale);
+      clip.scaleTimes.push_back(0.0f);
+    }
+  }
+}
+
+// Appends the triangles of the mesh to the model as a submesh starting at its own base vertex, with the largest weights
+// of its bones attached to the vertices by bone index and renormalized
+void loadMesh(const BoneIndexMap& boneIndices, const aiMesh* mesh, Model& model)
+{
+  std::vector<Vertex>& vertices = model.mesh.vertices;
+  std::vector<unsigned int>& indices = model.mesh.indices;
+
+  const size_t baseVertex = vertices.size();
+  model.mesh.submeshes.push_back({ static_cast<uint32_t>(indices.size()), mesh->mNumFaces * 3u,
+                                   static_cast<uint32_t>(baseVertex), static_cast<uint32_t>(maxInfluenceCount) });
+
+  // Load the indices
+  indices.reserve(indices.size() + static_cast<size_t>(mesh->mNumFaces) * 3u);
+  for (unsigned int i = 0u; i < mesh->mNumFaces; ++i)
+  {
+    const aiFace& face = mesh->mFaces[i];
+    assert(face.mNumIndices == 3u);
+    indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
+  }
+
+  // Load the vertices
+  vertices.resize(baseVertex + mesh->mNumVertices);
+  for (unsigned int i = 0u; i < mesh->mNumVertices; ++i)
+  {
+    Vertex& vertex = vertices.at(baseVertex + i);
+
+    // Position
+    {
+      const aiVector3D& position = mesh->mVertices[i];
+      vertex.position = glm::vec3(position.x, position.y, position.z);
+    }
+
+    // Normal
+    {
+      const aiVector3D& normal = mesh->mNormals[i];
+      vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+    }
+
+    // These will be set in the next step
+    std::fill(std::begin(vertex.boneIds), std::end(vertex.boneIds), -1);
+    std::fill(std::begin(vertex.boneWeights), std::end(vertex.boneWeights), 0.0f);
+  }
+
+  // Count the influences of each vertex, Assimp stores the weights by bone
+  std::vector<uint32_t> influenceOffsets(mesh->mNumVertices + 1u, 0u);
+  for (unsigned int i = 0u; i < mesh->mNumBones; ++i)
+  {
+    const aiBone* boneInfo = mesh->mBones[i];
+    for (unsigned int j = 0u; j < boneInfo->mNumWeights; ++j)
+    {
+      ++influenceOffsets.at(boneInfo->mWeights[j].mVertexId + 1u);
+    }
+  }
+
+  // Gather the influences by vertex, each vertex owns the range up to the offset of the next one
+  for (size_t i = 1u; i < influenceOffsets.size(); ++i)
+  {
+    influenceOffsets.at(i) += influenceOffsets.at(i - 1u);
+  }
+  std::vector<std::pair<float, int>> influences(influenceOffsets.back()); // Weight and bone index
+  std::vector<uint32_t> influenceEnds(influenceOffsets.begin(), influenceOffsets.end() - 1);
+  for (unsigned int i = 0u; i < mesh->mNumBones; ++i)
+  {
+    const aiBone* boneInfo = mesh->mBones[i];
+    const int boneIndex = findNamedBone(boneIndices, boneInfo->mName);
+    for (unsigned int j = 0u; j < boneInfo->mNumWeights; ++j)
+    {
+      const aiVertexWeight& weight = boneInfo->mWeights[j];
+      influences.at(influenceEnds.at(weight.mVertexId)++) = { weight.mWeight, boneIndex };
+    }
+  }
+
+  // Keep the largest weights of each vertex and renormalize them so that dropping the smallest ones does not shrink
+  // the vertex towards the origin
+  for (unsigned int i = 0u; i < mesh->mNumVertices; ++i)
+  {
+    const auto begin = influences.begin() + influenceOffsets.at(i);
+    const auto end = influences.begin() + influenceOffsets.at(i + 1u);
+    const auto keptEnd = begin + std::min(end - begin, std::ptrdiff_t(maxInfluenceCount));
+    std::partial_sort(begin, keptEnd, end, std::greater<std::pair<float, int>>());
+
+    float weightSum = 0.0f;
+    for (auto influence = begin; influence != keptEnd; ++influence)
+    {
+      weightSum += std::max(influence->first, 0.0f);
+    }
+
+    Vertex& vertex = vertices.at(baseVertex + i);
+    for (auto influence = begin; influence != keptEnd && influence->first > 0.0f; ++influence)
+    {
+      const size_t element = static_cast<size_t>(influence - begin);
+      vertex.boneIds[element] = influence->second;
+      vertex.boneWeights[element] = influence->first / weightSum;
+    }
+  }
+}
+
+// Reorders the bones so that each parent comes before its children, the bone order lists the unsorted bone indices in
+// their new order and bones missing from it are appended as roots
+void sortBones(std::vector<int> boneOrder, Model& model, std::vector<Clip>& clips)
+{
+  std::vector<Bone>& bones = model.skeleton.bones;
+
+  std::vector<int> sortedIndices(bones.size(), -1); // Maps an unsorted to a sorted bone index
+  for (size_t i = 0u; i < boneOrder.size(); ++i)
+  {
+    sortedIndices.at(boneOrder.at(i)) = static_cast<int>(i);
+  }
+
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    if (sortedIndices.at(i) < 0)
+    {
+      sortedIndices.at(i) = static_cast<int>(boneOrder.size());
+      boneOrder.push_back(static_cast<int>(i));
+      bones.at(i).parent = -1;
+    }
+  }
+
+  // Move the bones into their sorted position and remap their parents
+  std::vector<Bone> sortedBones(bones.size());
+  for (size_t i = 0u; i < sortedBones.size(); ++i)
+  {
+    Bone& bone = sortedBones.at(i);
+    bone = bones.at(boneOrder.at(i));
+    if (bone.parent >= 0)
+    {
+      bone.parent = sortedIndices.at(bone.parent);
+    }
+  }
+  bones = std::move(sortedBones);
+
+  // Move the tracks of each clip along with their bones
+  for (Clip& clip : clips)
+  {
+    std::vector<Track> sortedTranslationTracks(bones.size()), sortedRotationTracks(bones.size()),
+      sortedScaleTracks(bones.size());
+    for (size_t i = 0u; i < bones.size(); ++i)
+    {
+      const int unsortedIndex = boneOrder.at(i);
+      sortedTranslationTracks.at(i) = clip.translationTracks.at(unsortedIndex);
+      sortedRotationTracks.at(i) = clip.rotationTracks.at(unsortedIndex);
+      sortedScaleTracks.at(i) = clip.scaleTracks.at(unsortedIndex);
+    }
+    clip.translationTracks = std::move(sortedTranslationTracks);
+    clip.rotationTracks = std::move(sortedRotationTracks);
+    clip.scaleTracks = std::move(sortedScaleTracks);
+  }
+
+  // Remap the bones affecting each vertex
+  for (Vertex& vertex : model.mesh.vertices)
+  {
+    for (int element = 0; element < maxInfluenceCount; ++element)
+    {
+      if (vertex.boneIds[element] >= 0)
+      {
+        vertex.boneIds[element] = sortedIndices.at(vertex.boneIds[element]);
+      }
+    }
+  }
+}
+
+} // namespace
+
+BoneIndexMap buildBoneIndexMap(const aiScene* scene)
+{
+  BoneIndexMap boneIndices;
+  for (unsigned int i = 0u; i < scene->mNumMeshes; ++i)
+  {
+    const aiMesh* mesh = scene->mMeshes[i];
+    boneIndices.reserve(boneIndices.size() + mesh->mNumBones);
+    for (unsigned int j = 0u; j < mesh->mNumBones; ++j)
+    {
+      // Bones already skinning an earlier mesh keep their index
+      boneIndices.emplace(assimpToStringView(mesh->mBones[j]->mName), static_cast<int>(boneIndices.size()));
+    }
+  }
+  return boneIndices;
+}
+
+int findNamedBone(const BoneIndexMap& boneIndices, const aiString& name)
+{
+  const BoneIndexMap::const_iterator bone = boneIndices.find(assimpToStringView(name));
+  return bone != boneIndices.end() ? bone->second : -1;
+}
+
+void importScene(const aiScene* scene, Model& model)
+{
+  POSER_PROFILE_SCOPE("Import scene");
+  model = Model();
+  std::vector<Bone>& bones = model.skeleton.bones;
+
+  // Bones are looked up by name for every node and animation channel, so index their names once up front, the meshes
+  // share a single skeleton with the bones of all of them
+  const BoneIndexMap boneIndices = buildBoneIndexMap(scene);
+  bones.resize(boneIndices.size());
+
+  // Store the inverse bind matrix of each bone from the meshes it skins, including those skipped below so that every
+  // bone gets one, meshes skinned to the same skeleton share it
+  for (unsigned int i = 0u; i < scene->mNumMeshes; ++i)
+  {
+    const aiMesh* mesh = scene->mMeshes[i];
+    for (unsigned int j = 0u; j < mesh->mNumBones; ++j)
+    {
+      const aiBone* boneInfo = mesh->mBones[j];
+      bones.at(findNamedBone(boneIndices, boneInfo->mName)).inverseBindMatrix =
+        assimpToAffineTransform(boneInfo->mOffsetMatrix);
+    }
+  }
+
+  // Load every mesh into a submesh except for those the sorting by primitive type split off with points or lines
+  for (unsigned int i = 0u; i < scene->mNumMeshes; ++i)
+  {
+    const aiMesh* mesh = scene->mMeshes[i];
+    if ((mesh->mPrimitiveTypes & (aiPrimitiveType_POINT | aiPrimitiveType_LINE)) == 0u)
+    {
+      loadMesh(boneIndices, mesh, model);
+    }
+  }
+
+  // Load the skeleton
+  std::vector<int> boneOrder;
+  std::vector<RestTransform> restTransforms(bones.size());
+  boneOrder.reserve(bones.size());
+  loadSkeletonNode(boneIndices, scene->mRootNode, -1, model.skeleton, restTransforms, boneOrder);
+
+  // Load every animation into a clip, the tracks are remapped from channel names to bone indices once here, models
+  // without animations get a clip holding the rest pose
+  std::vector<Clip> clips(std::max(scene->mNumAnimations, 1u));
+  std::vector<std::string> clipNames(clips.size(), restPoseClipName);
+  for (size_t i = 0u; i < clips.size(); ++i)
+  {
+    Clip& clip = clips.at(i);
+    clip.translationTracks.resize(bones.size());
+    clip.rotationTracks.resize(bones.size());
+    clip.scaleTracks.resize(bones.size());
+    if (i < scene->mNumAnimations)
+    {
+      const aiAnimation* animation = scene->mAnimations[i];
+      loadClip(boneIndices, animation, clip);
+      clipNames.at(i) = animation->mName.length > 0u ? animation->mName.C_Str() : "Animation " + std::to_string(i);
+    }
+    addMissingKeyframes(restTransforms, clip);
+  }
+
+  sortBones(std::move(boneOrder), model, clips);
+  for (size_t i = 0u; i < clips.size(); ++i)
+  {
+    model.clips.addClip(std::move(clipNames.at(i)), std::move(clips.at(i)));
+  }
+
+  // Batch the submeshes into as few draws as possible, group them by influence count, reorder the triangles of each
+  // group and the vertices of each batch for rendering and pack them now that their bone ids are final, the influences
+  // that would not survive packing are dropped first so that the influence counts match those of the packed vertices
+  dropZeroWeightInfluences(chooseVertexFormat(bones.size()), model.mesh.vertices);
+  batchSubmeshes(model.mesh);
+  splitSubmeshesByInfluenceCount(model.mesh);
+  optimizeMesh(model.mesh);
+  model.mesh.influenceCount = getInfluenceCount(model.mesh.vertices);
+  packVertices(bones.size(), model.mesh);
+  packIndices(model.mesh);
+}
+
+const aiScene* readScene(Assimp::Importer& importer, std::unique_ptr<aiScene>& syntheticScene, const char* fileName)
+{
+  POSER_PROFILE_SCOPE("Read scene");
+  if (isSyntheticModelName(fileName))
+  {
+    SyntheticRig rig;
+    if (!parseSyntheticModelName(fileName, rig))
+    {
+      return nullptr;
+    }
+    syntheticScene = makeSyntheticScene(rig);
+    return syntheticScene.get();
+  }
+
+  constexpr int flags =
+    aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_JoinIdenticalVertices | aiProcess_GenNormals;
+  const aiScene* scene = importer.ReadFile(fileName, flags);
+  if (!scene)
+  {
+    std::cerr << "Failed to load model:\n" << importer.GetErrorString();
+  }
+  return scene;
+}
+
+bool importModel(const char* fileName, Model& model)
+{
+  POSER_PROFILE_SCOPE("Import model");
+  Assimp::Importer importer;
+  std::unique_ptr<aiScene> syntheticScene;
+  const aiScene* scene = readScene(importer, syntheticScene, fileName);
+  if (!scene)
+  {
+    return false;
+  }
+
+  importScene(scene, model);
+  return true;
+}
+
+} // namespace poser
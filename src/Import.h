@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Model.h"
+
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+struct aiScene;
+struct aiString;
+
+namespace Assimp
+{
+class Importer;
+}
+
+namespace poser
+{
+
+// Maps bone names to bone indices
+using BoneIndexMap = std::unordered_map<std::string_view, int>;
+
+// Maps the names of the bones of all meshes of the scene to their index in the shared skeleton, the names point into
+// the scene and share its lifetime
+BoneIndexMap buildBoneIndexMap(const aiScene* scene);
+
+// Returns the index of the named bone or -1 if there is no such bone
+int findNamedBone(const BoneIndexMap& boneIndices, const aiString& name);
+
+// Converts all meshes and animations of the scene into the model, the meshes become submeshes skinned to a single
+// skeleton and the animations clips in its clip library
+void importScene(const aiScene* scene, Model& model);
+
+// Parses the model file through Assimp with the post-processing the import relies on, the scene is owned by the
+// importer, or builds the scene of a synthetic model name (see Synthetic.h) into the synthetic scene, returns nullptr
+// on failure
+const aiScene* readScene(Assimp::Importer& importer, std::unique_ptr<aiScene>& syntheticScene, const char* fileName);
+
+// Imports the model file through Assimp or builds the synthetic model
+bool importModel(const char* fileName, Model& model);
+
+} // namespace poser
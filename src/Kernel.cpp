@@ -0,0 +1,36 @@
+#include "Kernel.h"
+
+#include "Lanes.h"
+
+namespace poser
+{
+
+std::vector<Kernel> getKernels()
+{
+  return
+  {
+    Kernel::Scalar,
+#if defined(POSER_SSE)
+    Kernel::Sse,
+#endif
+#if defined(POSER_AVX2)
+    Kernel::Avx2,
+#endif
+  };
+}
+
+const char* getKernelName(Kernel kernel)
+{
+  switch (kernel)
+  {
+  case Kernel::Scalar:
+    return "Scalar";
+  case Kernel::Sse:
+    return "SSE";
+  case Kernel::Avx2:
+    return "AVX2";
+  }
+  return "Unknown";
+}
+
+} // namespace poser
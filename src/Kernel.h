@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+namespace poser
+{
+
+// SIMD kernels, the same computation on different SIMD lanes
+enum class Kernel
+{
+  Scalar, // One element at a time
+  Sse,    // Four elements at a time
+  Avx2    // Eight elements at a time
+};
+
+// Returns the kernels available in this build, narrowest first
+std::vector<Kernel> getKernels();
+
+const char* getKernelName(Kernel kernel);
+
+} // namespace poser
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "Affine.h"
+#include "Kernel.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+  #define POSER_AVX2
+  #define POSER_SSE
+  #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define POSER_SSE
+  #include <emmintrin.h>
+#endif
+
+// SIMD lanes used by the kernels, each lane type provides the same operations on a different number of floats at once
+// so that the kernels can be written once as templates
+
+namespace poser
+{
+
+// Scalar lanes definition, the fallback for the SIMD lanes below that processes one element at a time
+struct ScalarLanes
+{
+  static constexpr size_t width = 1u;
+
+  float value;
+
+  static ScalarLanes load(const float* source)
+  {
+    return { *source };
+  }
+
+  static ScalarLanes broadcast(float value)
+  {
+    return { value };
+  }
+
+  // Loads the floats at the offsets from the base pointer
+  static ScalarLanes gather(const float* base, const int32_t* offsets)
+  {
+    return { base[offsets[0]] };
+  }
+
+  void store(float* destination) const
+  {
+    *destination = value;
+  }
+
+  // Loads the four consecutive floats at each offset from the base pointer and transposes them into four lanes
+  static void gatherTransposed(const float* base, const int32_t* offsets, ScalarLanes (&lanes)[4])
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      lanes[i].value = base[offsets[0] + i];
+    }
+  }
+
+  // Transposes the four lanes and stores them as four consecutive floats for each of the first count lanes, the
+  // destinations are the given stride (in floats) apart
+  static void storeTransposed(const ScalarLanes (&lanes)[4], float* destination, size_t, size_t)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      destination[i] = lanes[i].value;
+    }
+  }
+
+  // Returns the value with its sign flipped in the lanes where the sign is negative
+  static ScalarLanes flipSign(ScalarLanes value, ScalarLanes sign)
+  {
+    return { std::signbit(sign.value) ? -value.value : value.value };
+  }
+
+  static ScalarLanes sqrt(ScalarLanes value)
+  {
+    return { std::sqrt(value.value) };
+  }
+
+  // Calculates a * b, the result may alias either operand
+  static void multiply(const AffineTransform& a, const AffineTransform& b, AffineTransform& result)
+  {
+    result = a * b;
+  }
+};
+
+inline ScalarLanes operator+(ScalarLanes a, ScalarLanes b)
+{
+  return { a.value + b.value };
+}
+
+inline ScalarLanes operator-(ScalarLanes a, ScalarLanes b)
+{
+  return { a.value - b.value };
+}
+
+inline ScalarLanes operator*(ScalarLanes a, ScalarLanes b)
+{
+  return { a.value * b.value };
+}
+
+inline ScalarLanes operator/(ScalarLanes a, ScalarLanes b)
+{
+  return { a.value / b.value };
+}
+
+#if defined(POSER_SSE)
+// SSE lanes definition, processes four elements at a time
+struct SseLanes
+{
+  static constexpr size_t width = 4u;
+
+  __m128 value;
+
+  static SseLanes load(const float* source)
+  {
+    return { _mm_loadu_ps(source) };
+  }
+
+  static SseLanes broadcast(float value)
+  {
+    return { _mm_set1_ps(value) };
+  }
+
+  static SseLanes gather(const float* base, const int32_t* offsets)
+  {
+    return { _mm_setr_ps(base[offsets[0]], base[offsets[1]], base[offsets[2]], base[offsets[3]]) };
+  }
+
+  void store(float* destination) const
+  {
+    _mm_storeu_ps(destination, value);
+  }
+
+  static void gatherTransposed(const float* base, const int32_t* offsets, SseLanes (&lanes)[4])
+  {
+    __m128 row0 = _mm_loadu_ps(base + offsets[0]), row1 = _mm_loadu_ps(base + offsets[1]),
+           row2 = _mm_loadu_ps(base + offsets[2]), row3 = _mm_loadu_ps(base + offsets[3]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    lanes[0].value = row0;
+    lanes[1].value = row1;
+    lanes[2].value = row2;
+    lanes[3].value = row3;
+  }
+
+  static void storeTransposed(const SseLanes (&lanes)[4], float* destination, size_t stride, size_t count)
+  {
+    __m128 row0 = lanes[0].value, row1 = lanes[1].value, row2 = lanes[2].value, row3 = lanes[3].value;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    const __m128 rows[4] = { row0, row1, row2, row3 };
+    for (size_t i = 0u; i < count; ++i)
+    {
+      _mm_storeu_ps(destination + i * stride, rows[i]);
+    }
+  }
+
+  static SseLanes flipSign(SseLanes value, SseLanes sign)
+  {
+    return { _mm_xor_ps(value.value, _mm_and_ps(sign.value, _mm_set1_ps(-0.0f))) };
+  }
+
+  static SseLanes sqrt(SseLanes value)
+  {
+    return { _mm_sqrt_ps(value.value) };
+  }
+
+  // Calculates each row of the result as the rows of b weighted by the elements of the same row of a plus the
+  // translation of a, all rows are calculated before storing any so that the result may alias either operand
+  static void multiply(const AffineTransform& a, const AffineTransform& b, AffineTransform& result)
+  {
+    const __m128 b0 = _mm_loadu_ps(&b.rows[0].x), b1 = _mm_loadu_ps(&b.rows[1].x), b2 = _mm_loadu_ps(&b.rows[2].x);
+    const __m128 translationMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    __m128 rows[3];
+    for (int row = 0; row < 3; ++row)
+    {
+      const __m128 weights = _mm_loadu_ps(&a.rows[row].x);
+      __m128 sum = _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+      rows[row] = _mm_add_ps(sum, _mm_and_ps(weights, translationMask));
+    }
+
+    for (int row = 0; row < 3; ++row)
+    {
+      _mm_storeu_ps(&result.rows[row].x, rows[row]);
+    }
+  }
+};
+
+inline SseLanes operator+(SseLanes a, SseLanes b)
+{
+  return { _mm_add_ps(a.value, b.value) };
+}
+
+inline SseLanes operator-(SseLanes a, SseLanes b)
+{
+  return { _mm_sub_ps(a.value, b.value) };
+}
+
+inline SseLanes operator*(SseLanes a, SseLanes b)
+{
+  return { _mm_mul_ps(a.value, b.value) };
+}
+
+inline SseLanes operator/(SseLanes a, SseLanes b)
+{
+  return { _mm_div_ps(a.value, b.value) };
+}
+#endif
+
+#if defined(POSER_AVX2)
+// AVX2 lanes definition, processes eight elements at a time
+struct Avx2Lanes
+{
+  static constexpr size_t width = 8u;
+
+  __m256 value;
+
+  static Avx2Lanes load(const float* source)
+  {
+    return { _mm256_loadu_ps(source) };
+  }
+
+  static Avx2Lanes broadcast(float value)
+  {
+    return { _mm256_set1_ps(value) };
+  }
+
+  static Avx2Lanes gather(const float* base, const int32_t* offsets)
+  {
+    return { _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets)), 4) };
+  }
+
+  void store(float* destination) const
+  {
+    _mm256_storeu_ps(destination, value);
+  }
+
+  // Transposes both halves of the lanes like the SSE lanes do
+  static void gatherTransposed(const float* base, const int32_t* offsets, Avx2Lanes (&lanes)[4])
+  {
+    SseLanes low[4], high[4];
+    SseLanes::gatherTransposed(base, offsets, low);
+    SseLanes::gatherTransposed(base, offsets + 4, high);
+    for (int i = 0; i < 4; ++i)
+    {
+      lanes[i].value = _mm256_insertf128_ps(_mm256_castps128_ps256(low[i].value), high[i].value, 1);
+    }
+  }
+
+  static void storeTransposed(const Avx2Lanes (&lanes)[4], float* destination, size_t stride, size_t count)
+  {
+    SseLanes low[4], high[4];
+    for (int i = 0; i < 4; ++i)
+    {
+      low[i].value = _mm256_castps256_ps128(lanes[i].value);
+      high[i].value = _mm256_extractf128_ps(lanes[i].value, 1);
+    }
+
+    SseLanes::storeTransposed(low, destination, stride, std::min(count, size_t(4u)));
+    if (count > 4u)
+    {
+      SseLanes::storeTransposed(high, destination + 4u * stride, stride, count - 4u);
+    }
+  }
+
+  static Avx2Lanes flipSign(Avx2Lanes value, Avx2Lanes sign)
+  {
+    return { _mm256_xor_ps(value.value, _mm256_and_ps(sign.value, _mm256_set1_ps(-0.0f))) };
+  }
+
+  static Avx2Lanes sqrt(Avx2Lanes value)
+  {
+    return { _mm256_sqrt_ps(value.value) };
+  }
+
+  // Like the SSE multiply, but calculates the first two rows of the result at once
+  static void multiply(const AffineTransform& a, const AffineTransform& b, AffineTransform& result)
+  {
+    const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&b.rows[0].x)),
+                 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&b.rows[1].x)),
+                 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&b.rows[2].x));
+    const __m256 translationMask = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+
+    const __m256 weights = _mm256_loadu_ps(&a.rows[0].x);
+    __m256 sum = _mm256_mul_ps(_mm256_permute_ps(weights, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_permute_ps(weights, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_permute_ps(weights, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+    sum = _mm256_add_ps(sum, _mm256_and_ps(weights, translationMask));
+
+    // The last row only needs the lower halves
+    const __m128 lastWeights = _mm_loadu_ps(&a.rows[2].x);
+    const __m128 lastB0 = _mm256_castps256_ps128(b0), lastB1 = _mm256_castps256_ps128(b1),
+                 lastB2 = _mm256_castps256_ps128(b2);
+    __m128 last = _mm_mul_ps(_mm_permute_ps(lastWeights, _MM_SHUFFLE(0, 0, 0, 0)), lastB0);
+    last = _mm_add_ps(last, _mm_mul_ps(_mm_permute_ps(lastWeights, _MM_SHUFFLE(1, 1, 1, 1)), lastB1));
+    last = _mm_add_ps(last, _mm_mul_ps(_mm_permute_ps(lastWeights, _MM_SHUFFLE(2, 2, 2, 2)), lastB2));
+    last = _mm_add_ps(last, _mm_and_ps(lastWeights, _mm256_castps256_ps128(translationMask)));
+
+    _mm256_storeu_ps(&result.rows[0].x, sum);
+    _mm_storeu_ps(&result.rows[2].x, last);
+  }
+};
+
+inline Avx2Lanes operator+(Avx2Lanes a, Avx2Lanes b)
+{
+  return { _mm256_add_ps(a.value, b.value) };
+}
+
+inline Avx2Lanes operator-(Avx2Lanes a, Avx2Lanes b)
+{
+  return { _mm256_sub_ps(a.value, b.value) };
+}
+
+inline Avx2Lanes operator*(Avx2Lanes a, Avx2Lanes b)
+{
+  return { _mm256_mul_ps(a.value, b.value) };
+}
+
+inline Avx2Lanes operator/(Avx2Lanes a, Avx2Lanes b)
+{
+  return { _mm256_div_ps(a.value, b.value) };
+}
+#endif
+
+// The widest lanes available in this build
+#if defined(POSER_AVX2)
+using SimdLanes = Avx2Lanes;
+#elif defined(POSER_SSE)
+using SimdLanes = SseLanes;
+#else
+using SimdLanes = ScalarLanes;
+#endif
+
+// Calls the function with a default constructed value of the lanes of the kernel, which must be available in this build
+template<typename Function>
+void dispatchKernel(Kernel kernel, Function&& function)
+{
+  switch (kernel)
+  {
+  case Kernel::Scalar:
+    function(ScalarLanes());
+    break;
+#if defined(POSER_SSE)
+  case Kernel::Sse:
+    function(SseLanes());
+    break;
+#endif
+#if defined(POSER_AVX2)
+  case Kernel::Avx2:
+    function(Avx2Lanes());
+    break;
+#endif
+  default:
+    assert(false && "Kernel not available in this build");
+    break;
+  }
+}
+
+// Interpolates between the quaternions in the lanes (as x, y, z and w lanes) along the shorter arc and normalizes the
+// results
+template<typename Lanes>
+void nlerpQuaternions(const Lanes (&a)[4], const Lanes (&b)[4], Lanes factor, Lanes (&result)[4])
+{
+  const Lanes dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  Lanes lengthSquared = Lanes::broadcast(0.0f);
+  for (int component = 0; component < 4; ++component)
+  {
+    const Lanes to = Lanes::flipSign(b[component], dot);
+    result[component] = a[component] + (to - a[component]) * factor;
+    lengthSquared = lengthSquared + result[component] * result[component];
+  }
+
+  const Lanes inverseLength = Lanes::broadcast(1.0f) / Lanes::sqrt(lengthSquared);
+  for (Lanes& component : result)
+  {
+    component = component * inverseLength;
+  }
+}
+
+// Multiplies the quaternions in the lanes (as x, y, z and w lanes), the results rotate by b first and then by a
+template<typename Lanes>
+void multiplyQuaternions(const Lanes (&a)[4], const Lanes (&b)[4], Lanes (&result)[4])
+{
+  const Lanes x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+  const Lanes y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+  const Lanes z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+  const Lanes w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+  result[0] = x;
+  result[1] = y;
+  result[2] = z;
+  result[3] = w;
+}
+
+} // namespace poser
@@ -1,32 +1,34 @@
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
+#include "Crowd.h"
+#include "FixedTimestep.h"
+#include "Model.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "VertexPacking.h"
+
 #include <glad/gl.h>
 #include <glfw/glfw3.h>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/quaternion.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace
 {
 
-// Vertex definition
-struct Vertex
+// Per-instance vertex attributes
+struct InstanceAttributes
 {
-  glm::vec3 position, normal;
-  glm::ivec4 boneIds;    // Which bones affect this vertex (indices into the bone and bone transform array)
-  glm::vec4 boneWeights; // How much each indexed bone affects this vertex, elements sum up to 1.0
-};
-
-// Bone definition
-struct Bone
-{
-  glm::mat4 inverseBindMatrix; // Inverse bind pose bone transform (transforms from unposed bone to model space origin)
-  glm::mat4 posedTransform;    // Posed bone transform in bone space (translation * rotation * scale)
-  std::vector<glm::mat4> translationKeyframes, rotationKeyframes, scaleKeyframes;
-  Bone* parent;
+  glm::vec3 position;
+  GLint paletteOffset; // Index of the first bone transform of the instance in the bone palette
 };
 
 // Window constants
@@ -39,7 +41,22 @@ constexpr float windowAspectRatio = static_cast<float>(windowWidth) / static_cas
 constexpr GLsizei shaderInfoLogLength = 512;
 
 // File constants
-constexpr char modelFileName[] = "models/silly_dancing.fbx";
+constexpr char defaultModelFileName[] = "models/silly_dancing.fbx";
+
+// Benchmark constants
+constexpr int defaultBenchmarkFrameCount = 1000;
+constexpr int defaultBenchmarkInstanceCount = 1;
+constexpr int benchmarkWarmUpFrameCount = 10;
+constexpr double benchmarkFrameTime = 1.0 / 60.0; // In seconds
+constexpr int paletteBenchmarkMaxInstanceCount = 10000;
+constexpr int paletteBenchmarkFrameCount = 100;
+
+// Clip constants
+constexpr double crossfadeDuration = 0.3; // In seconds
+
+// Simulation constants
+constexpr double defaultSimulationRate = 60.0; // In steps per second
+constexpr int maxSimulationStepsPerFrame = 4;  // Frames slower than this many steps slow the animation down instead
 
 // Color constants
 constexpr glm::vec4 clearColor = { 0.9f, 0.4f, 0.1f, 1.0f };
@@ -59,85 +76,292 @@ float cameraAngle = glm::radians(45.0f);
 float cameraDistance = 5.0f;
 double lastMouseX;
 
-// Geometry variables
-std::vector<Vertex> vertices;
-std::vector<unsigned int> indices;
+// Clip variables
+int clipStep = 0; // Clips to step through the clip library since the last frame
 
-// Animation variables
-std::vector<Bone> bones;
-std::vector<glm::mat4> boneTransforms; // Transforms from unposed to posed bone in model space
-unsigned int frameIndex = 0u;          // Current animation frame
+// Creates a window with an OpenGL 3.3 core context and loads OpenGL, returns nullptr on failure
+GLFWwindow* createWindow(bool visible)
+{
+  POSER_PROFILE_SCOPE("Create window");
+  if (!glfwInit())
+  {
+    std::cerr << "Failed to initialize GLFW";
+    return nullptr;
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+  GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, windowTitle, nullptr, nullptr);
+  if (!window)
+  {
+    std::cerr << "Failed to create window";
+    glfwTerminate();
+    return nullptr;
+  }
 
-glm::mat4 assimpToGlmMat4(const aiMatrix4x4& matrix)
+  glfwMakeContextCurrent(window);
+  if (gladLoadGL(glfwGetProcAddress) == 0)
+  {
+    std::cerr << "Failed to load OpenGL";
+    glfwTerminate();
+    return nullptr;
+  }
+
+  return window;
+}
+
+// Returns the size in bytes of a bone transform in the bone palette in the form that the skinning mode blends, a whole
+// number of RGBA texels
+size_t getBoneTransformSize(poser::SkinningMode skinningMode)
+{
+  static_assert(sizeof(poser::AffineTransform) % sizeof(glm::vec4) == 0u &&
+                sizeof(poser::DualQuaternion) % sizeof(glm::vec4) == 0u);
+  return skinningMode == poser::SkinningMode::DualQuaternion ? sizeof(poser::DualQuaternion)
+                                                             : sizeof(poser::AffineTransform);
+}
+
+// Returns false if the bone palette of that many instances exceeds the size limit of texture buffers
+bool isBonePaletteSupported(size_t instanceCount, size_t boneCount, poser::SkinningMode skinningMode)
 {
-  return glm::transpose(glm::make_mat4(&matrix.a1)); // Convert row-major (assimp) to column-major (glm)
+  GLint maxTexelCount;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexelCount);
+  const size_t texelCount = instanceCount * boneCount * getBoneTransformSize(skinningMode) / sizeof(glm::vec4);
+  if (texelCount > static_cast<size_t>(maxTexelCount))
+  {
+    std::cerr << "The bone palette of " << instanceCount << " instances with " << boneCount
+              << " bones exceeds the texture buffer size limit of " << maxTexelCount << " texels\n";
+    return false;
+  }
+  return true;
 }
 
-int findNamedBone(const aiScene* scene, const aiString& name)
+// Copies the bone transforms of all instances interpolated from their previous to their current transforms by the
+// factor back to back into the bone palette buffer in the form that the skinning mode blends, replacing its contents
+void uploadBonePalette(GLuint buffer,
+                       const std::vector<poser::Instance>& instances,
+                       const poser::Skeleton& skeleton,
+                       poser::SkinningMode skinningMode,
+                       float factor)
 {
-  const aiMesh* mesh = scene->mMeshes[0];
-  for (unsigned int i = 0u; i < mesh->mNumBones; ++i)
+  POSER_PROFILE_SCOPE("Upload bone palette");
+  const size_t boneCount = skeleton.bones.size();
+  const GLsizeiptr size = static_cast<GLsizeiptr>(getBoneTransformSize(skinningMode) * boneCount * instances.size());
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+
+  // Orphan the previous contents so that writing does not have to wait for draws still reading them
+  glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  if (size == 0)
+  {
+    return;
+  }
+
+  constexpr GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+  void* palette = glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, access);
+  for (size_t i = 0u; i < instances.size(); ++i)
   {
-    if (mesh->mBones[i]->mName == name)
+    const poser::Pose& pose = instances[i].pose;
+    if (skinningMode == poser::SkinningMode::DualQuaternion)
+    {
+      poser::interpolateBoneTransforms(pose, factor, static_cast<poser::DualQuaternion*>(palette) + i * boneCount);
+    }
+    else
     {
-      return static_cast<int>(i);
+      poser::interpolateBoneTransforms(skeleton, pose, factor,
+                                       static_cast<poser::AffineTransform*>(palette) + i * boneCount);
     }
   }
+  glUnmapBuffer(GL_TEXTURE_BUFFER);
+}
+
+// Fills a new vertex buffer with the packed vertices and applies their definition to the bound vertex array, the bone
+// ids and weights use the given unsigned integer type, influences past the first 4 go to a second pair of attributes
+template<typename Component>
+void uploadPackedVertices(const std::vector<poser::PackedVertex<Component>>& vertices, GLenum componentType)
+{
+  using VertexType = poser::PackedVertex<Component>;
+
+  GLuint vertexBuffer;
+  glGenBuffers(1, &vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(VertexType) * vertices.size()), vertices.data(),
+               GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexType),
+                        reinterpret_cast<void*>(offsetof(VertexType, position)));
 
-  return -1;
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(VertexType),
+                        reinterpret_cast<void*>(offsetof(VertexType, normal)));
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribIPointer(2, 4, componentType, sizeof(VertexType),
+                         reinterpret_cast<void*>(offsetof(VertexType, boneIds)));
+
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 4, componentType, GL_TRUE, sizeof(VertexType),
+                        reinterpret_cast<void*>(offsetof(VertexType, boneWeights)));
+
+  if constexpr (poser::maxInfluenceCount > 4)
+  {
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(6, 4, componentType, sizeof(VertexType),
+                           reinterpret_cast<void*>(offsetof(VertexType, boneIds) + 4u * sizeof(Component)));
+
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 4, componentType, GL_TRUE, sizeof(VertexType),
+                          reinterpret_cast<void*>(offsetof(VertexType, boneWeights) + 4u * sizeof(Component)));
+  }
 }
 
-void loadSkeletonNode(const aiScene* scene, const aiNode* node, Bone* parent)
+// Loads the model and then poses the instances for the given number of frames like the viewer does, but without a
+// window or OpenGL, and writes the load time and the frame time statistics to the standard output as JSON
+bool benchmarkFrames(const char* fileName, int frameCount, int instanceCount, unsigned int threadCount)
 {
-  const int boneIndex = findNamedBone(scene, node->mName);
-  if (boneIndex >= 0)
+  using Clock = std::chrono::steady_clock;
+
+  poser::Model model;
+  const Clock::time_point loadStart = Clock::now();
+  bool loadedFromCache;
+  if (!poser::loadModel(fileName, model, loadedFromCache))
   {
-    Bone& bone = bones.at(boneIndex);
-    bone.parent = parent;
-    parent = &bone;
+    return false;
   }
+  const double loadMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count();
 
-  // Process the children of this node recursively
-  for (unsigned int i = 0u; i < node->mNumChildren; ++i)
+  std::vector<poser::Instance> instances = poser::createInstances(model, instanceCount);
+  poser::ThreadPool threadPool(threadCount);
+
+  // Warm up the caches and the thread pool before measuring
+  for (int frame = 0; frame < benchmarkWarmUpFrameCount; ++frame)
   {
-    loadSkeletonNode(scene, node->mChildren[i], parent);
+    poser::updateAnimations(threadPool, model, instances, frame * benchmarkFrameTime,
+                            poser::SkinningMode::LinearBlend);
   }
+
+  std::vector<double> frameMilliseconds(static_cast<size_t>(frameCount));
+  for (int frame = 0; frame < frameCount; ++frame)
+  {
+    const Clock::time_point start = Clock::now();
+    poser::updateAnimations(threadPool, model, instances,
+                            (benchmarkWarmUpFrameCount + frame) * benchmarkFrameTime,
+                            poser::SkinningMode::LinearBlend);
+    frameMilliseconds.at(frame) = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  double totalMilliseconds = 0.0;
+  for (const double milliseconds : frameMilliseconds)
+  {
+    totalMilliseconds += milliseconds;
+  }
+  std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+
+  const double totalSeconds = totalMilliseconds / 1.0e3;
+  const double posedInstances = static_cast<double>(instanceCount) * frameCount;
+  const double posedBones = posedInstances * static_cast<double>(model.skeleton.bones.size());
+
+  std::cout << "{\n";
+  std::cout << "  \"model\": ";
+  poser::writeJsonString(std::cout, fileName);
+  std::cout << ",\n";
+  std::cout << "  \"vertices\": " << model.mesh.vertices.size() << ",\n";
+  std::cout << "  \"bones\": " << model.skeleton.bones.size() << ",\n";
+  std::cout << "  \"load\": { \"milliseconds\": " << loadMilliseconds << ", \"fromCache\": "
+            << (loadedFromCache ? "true" : "false") << " },\n";
+  std::cout << "  \"frames\": " << frameCount << ",\n";
+  std::cout << "  \"instances\": " << instanceCount << ",\n";
+  std::cout << "  \"threads\": " << threadPool.getThreadCount() << ",\n";
+  std::cout << "  \"frameMilliseconds\": { \"mean\": " << totalMilliseconds / frameCount
+            << ", \"p50\": " << poser::getPercentile(frameMilliseconds, 50.0)
+            << ", \"p99\": " << poser::getPercentile(frameMilliseconds, 99.0)
+            << ", \"min\": " << frameMilliseconds.front() << ", \"max\": " << frameMilliseconds.back() << " },\n";
+  std::cout << "  \"throughput\": { \"framesPerSecond\": " << frameCount / totalSeconds
+            << ", \"instancesPerSecond\": " << posedInstances / totalSeconds
+            << ", \"bonesPerSecond\": " << posedBones / totalSeconds << " }\n";
+  std::cout << "}\n";
+  return true;
 }
 
-void updateAnimation()
+
+// Measures the time to upload the bone palette of all instances once per frame with each skinning mode as the instance
+// count grows, the upload needs an OpenGL context so this opens a hidden window
+bool benchmarkPaletteUpload(const char* fileName)
 {
-  // Update the new posed transform at the current animation frame for each bone in bone space
-  for (size_t i = 0u; i < bones.size(); ++i)
-  {
-    Bone& bone = bones.at(i);
+  using Clock = std::chrono::steady_clock;
 
-    const glm::mat4 translation = bone.translationKeyframes.at(frameIndex % bone.translationKeyframes.size());
-    const glm::mat4 rotation = bone.rotationKeyframes.at(frameIndex % bone.rotationKeyframes.size());
-    const glm::mat4 scale = bone.scaleKeyframes.at(frameIndex % bone.scaleKeyframes.size());
+  poser::Model model;
+  bool loadedFromCache;
+  if (!poser::loadModel(fileName, model, loadedFromCache))
+  {
+    return false;
+  }
 
-    bone.posedTransform = translation * rotation * scale;
+  GLFWwindow* window = createWindow(false);
+  if (!window)
+  {
+    return false;
   }
 
-  // Update the transform from the unposed to the posed bone for each bone in model space
-  for (size_t i = 0u; i < bones.size(); ++i)
+  GLuint paletteBuffer;
+  glGenBuffers(1, &paletteBuffer);
+
+  const size_t boneCount = model.skeleton.bones.size();
+  std::cout << "Model: " << fileName << " (" << boneCount << " bones)\n";
+  for (int instanceCount = 1; instanceCount <= paletteBenchmarkMaxInstanceCount; instanceCount *= 10)
   {
-    const Bone& bone = bones.at(i);
+    if (!isBonePaletteSupported(static_cast<size_t>(instanceCount), boneCount, poser::SkinningMode::LinearBlend))
+    {
+      break;
+    }
+
+    // Posing for dual quaternion skinning also updates the affine bone transforms
+    std::vector<poser::Instance> instances = poser::createInstances(model, instanceCount);
+    for (poser::Instance& instance : instances)
+    {
+      poser::updateAnimation(model, instance, 0.0, poser::SkinningMode::DualQuaternion);
+    }
 
-    // Find the posed bone transform in model space (transforms from the model space origin to the posed bone)
-    glm::mat4 posedTransform = bone.posedTransform;
+    for (const poser::SkinningMode skinningMode :
+         { poser::SkinningMode::LinearBlend, poser::SkinningMode::DualQuaternion })
     {
-      // Multiply the posed bone transforms of all previous bones in the hierarchy to find the posed bone transform
-      Bone* parent = bone.parent;
-      while (parent)
+      // Wait for the GPU after each frame so that the time includes the transfer
+      const Clock::time_point start = Clock::now();
+      for (int frame = 0; frame < paletteBenchmarkFrameCount; ++frame)
       {
-        posedTransform = parent->posedTransform * posedTransform;
-        parent = parent->parent;
+        uploadBonePalette(paletteBuffer, instances, model.skeleton, skinningMode, 1.0f);
+        glFinish();
       }
+      const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count() / paletteBenchmarkFrameCount;
+
+      const double bytes = static_cast<double>(getBoneTransformSize(skinningMode) * boneCount) * instanceCount;
+      std::cout << poser::getSkinningModeName(skinningMode) << ", " << instanceCount << " instances: "
+                << bytes / 1024.0 << " KiB, " << seconds * 1.0e3 << " ms per frame ("
+                << bytes / seconds / (1024.0 * 1024.0) << " MiB/s)\n";
     }
+  }
+
+  glDeleteBuffers(1, &paletteBuffer);
+  glfwTerminate();
+  return true;
+}
 
-    // Store the transform from the unposed to the posed bone in model space by transforming from the unposed bone to
-    // the model space origin (through the inverse bind matrix) and then from there to the posed bone in model space
-    boneTransforms.at(i) = posedTransform * bone.inverseBindMatrix;
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+  // Step through the clips
+  if (action == GLFW_PRESS || action == GLFW_REPEAT)
+  {
+    if (key == GLFW_KEY_RIGHT)
+    {
+      ++clipStep;
+    }
+    else if (key == GLFW_KEY_LEFT)
+    {
+      --clipStep;
+    }
   }
 }
 
@@ -171,188 +395,368 @@ void scrollCallback(GLFWwindow* window, double x, double y)
   }
 }
 
-} // namespace
-
-int main()
+// Compiles and links the shader program skinning with the skinning mode and the given influence count, which its
+// influence loops get unrolled for, and sets its constant uniforms, returns false if it fails
+bool createShaderProgram(poser::SkinningMode skinningMode,
+                         int influenceCount,
+                         GLuint& program,
+                         GLint& viewUniformLocation)
 {
-  // Create window and load OpenGL
-  GLFWwindow* window;
+  // Compile the vertex shader
+  GLuint vertexShader;
   {
-    if (!glfwInit())
+    vertexShader = glCreateShader(GL_VERTEX_SHADER);
+
+    // The skinning mode and the influence count select the variant through definitions between the version and the
+    // rest of the source, the influence count unrolls the influence loops
+    const GLchar* version = "#version 330 core\n";
+    const std::string definitions =
+      "#define INFLUENCE_COUNT " + std::to_string(influenceCount) + "\n" +
+      (skinningMode == poser::SkinningMode::DualQuaternion ? "#define DUAL_QUATERNION_SKINNING\n" : "");
+    const GLchar* source = R"(uniform mat4 view;
+                              uniform mat4 projection;
+                              uniform samplerBuffer bonePalette;
+                              layout(location = 0) in vec3 inPosition;
+                              layout(location = 1) in vec2 inNormal;
+                              layout(location = 2) in uvec4 inBoneIds;
+                              layout(location = 3) in vec4 inBoneWeights;
+                              layout(location = 4) in vec3 inInstancePosition;
+                              layout(location = 5) in int inPaletteOffset;
+                              #if INFLUENCE_COUNT > 4
+                              layout(location = 6) in uvec4 inExtraBoneIds;
+                              layout(location = 7) in vec4 inExtraBoneWeights;
+                              int getBoneId(int i)
+                              {
+                                return int(i < 4 ? inBoneIds[i] : inExtraBoneIds[i - 4]);
+                              }
+                              float getBoneWeight(int i)
+                              {
+                                return i < 4 ? inBoneWeights[i] : inExtraBoneWeights[i - 4];
+                              }
+                              #else
+                              int getBoneId(int i)
+                              {
+                                return int(inBoneIds[i]);
+                              }
+                              float getBoneWeight(int i)
+                              {
+                                return inBoneWeights[i];
+                              }
+                              #endif
+                              out vec3 normal;
+                              vec3 decodeNormal()
+                              {
+                                vec3 decoded = vec3(inNormal, 1.0 - abs(inNormal.x) - abs(inNormal.y));
+                                float fold = max(-decoded.z, 0.0);
+                                decoded.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(decoded.xy, vec2(0.0)));
+                                return decoded;
+                              }
+                              #ifdef DUAL_QUATERNION_SKINNING
+                              vec3 rotate(vec4 rotation, vec3 vector)
+                              {
+                                return vector + 2.0 * cross(rotation.xyz, cross(rotation.xyz, vector) +
+                                                                              rotation.w * vector);
+                              }
+                              void skin(out vec3 position, out vec3 skinnedNormal)
+                              {
+                                int pivotTexel = (inPaletteOffset + getBoneId(0)) * 2;
+                                vec4 pivot = texelFetch(bonePalette, pivotTexel);
+                                vec4 real = vec4(0.0), dual = vec4(0.0);
+                                for (int i = 0; i < INFLUENCE_COUNT; ++i)
+                                {
+                                  if (getBoneWeight(i) > 0.0)
+                                  {
+                                    int texel = (inPaletteOffset + getBoneId(i)) * 2;
+                                    vec4 boneReal = texelFetch(bonePalette, texel);
+                                    float weight = dot(boneReal, pivot) < 0.0 ? -getBoneWeight(i) : getBoneWeight(i);
+                                    real += boneReal * weight;
+                                    dual += texelFetch(bonePalette, texel + 1) * weight;
+                                  }
+                                }
+                                float inverseLength = 1.0 / length(real);
+                                real *= inverseLength;
+                                dual *= inverseLength;
+                                vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz +
+                                                          cross(real.xyz, dual.xyz));
+                                position = rotate(real, inPosition) + translation;
+                                skinnedNormal = rotate(real, decodeNormal());
+                              }
+                              #else
+                              mat3x4 getBoneTransform(int bone)
+                              {
+                                int texel = (inPaletteOffset + bone) * 3;
+                                return mat3x4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+                                              texelFetch(bonePalette, texel + 2));
+                              }
+                              void skin(out vec3 position, out vec3 skinnedNormal)
+                              {
+                                mat3x4 boneTransform = mat3x4(0.0);
+                                for (int i = 0; i < INFLUENCE_COUNT; ++i)
+                                {
+                                  if (getBoneWeight(i) > 0.0)
+                                  {
+                                    boneTransform += getBoneTransform(getBoneId(i)) * getBoneWeight(i);
+                                  }
+                                }
+                                position = vec4(inPosition, 1.0) * boneTransform;
+                                skinnedNormal = vec4(decodeNormal(), 0.0) * boneTransform;
+                              }
+                              #endif
+                              void main()
+                              {
+                                vec3 position, skinnedNormal;
+                                skin(position, skinnedNormal);
+                                gl_Position = projection * view * vec4(position + inInstancePosition, 1.0);
+                                normal = normalize(skinnedNormal);
+                              })";
+
+    const GLchar* sources[] = { version, definitions.c_str(), source };
+    glShaderSource(vertexShader, 3, sources, nullptr);
+    glCompileShader(vertexShader);
+
+    GLint success;
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success)
     {
-      std::cerr << "Failed to initialize GLFW";
-      return EXIT_FAILURE;
+      GLchar infoLog[shaderInfoLogLength];
+      glGetShaderInfoLog(vertexShader, shaderInfoLogLength, nullptr, infoLog);
+      std::cerr << "Failed to compile vertex shader:\n" << infoLog;
+      return false;
     }
+  }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    window = glfwCreateWindow(windowWidth, windowHeight, windowTitle, nullptr, nullptr);
-    if (!window)
+  // Compile the fragment shader
+  GLuint fragmentShader;
+  {
+    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    const GLchar* source = R"(#version 150 core
+                              uniform vec4 color;
+                              in vec3 normal;
+                              out vec4 fragColor;
+                              void main()
+                              {
+                                float diffuse = dot(normal, vec3(1.0));
+                                fragColor = vec4(color.rgb * diffuse, color.a);
+                              })";
+
+    glShaderSource(fragmentShader, 1, &source, nullptr);
+    glCompileShader(fragmentShader);
+
+    GLint success;
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success)
     {
-      std::cerr << "Failed to create window";
-      glfwTerminate();
-      return EXIT_FAILURE;
+      GLchar infoLog[shaderInfoLogLength];
+      glGetShaderInfoLog(fragmentShader, shaderInfoLogLength, nullptr, infoLog);
+      std::cerr << "Failed to compile fragment shader:\n" << infoLog;
+      return false;
     }
+  }
 
-    glfwSetCursorPosCallback(window, cursorPositionCallback);
-    glfwSetMouseButtonCallback(window, mouseButtonCallback);
-    glfwSetScrollCallback(window, scrollCallback);
+  // Link shader program
+  {
+    program = glCreateProgram();
 
-    glfwMakeContextCurrent(window);
-    if (gladLoadGL(glfwGetProcAddress) == 0)
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+
+    glLinkProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
     {
-      std::cerr << "Failed to load OpenGL";
-      return EXIT_FAILURE;
+      GLchar infoLog[shaderInfoLogLength];
+      glGetProgramInfoLog(program, shaderInfoLogLength, nullptr, infoLog);
+      std::cerr << "Failed to link shader program:\n" << infoLog;
+      return false;
     }
 
-    glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
-    glEnable(GL_DEPTH_TEST);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
   }
 
-  // Load a model
+  // Use shader program, retrieve uniform locations and set constant uniform values
   {
-    Assimp::Importer importer;
+    glUseProgram(program);
 
-    // Parse the file
-    constexpr int flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenNormals;
-    const aiScene* scene = importer.ReadFile(modelFileName, flags);
-    if (!scene)
+    // Retrieve view matrix location
     {
-      std::cerr << "Failed to load model:\n" << importer.GetErrorString();
-      glfwTerminate();
-      return EXIT_FAILURE;
+      viewUniformLocation = glGetUniformLocation(program, "view");
+      if (viewUniformLocation < 0)
+      {
+        std::cerr << "Failed to get view matrix uniform location";
+        return false;
+      }
     }
 
-    // Load the first mesh if there is one
-    if (scene->mNumMeshes > 0)
+    // Set bone palette texture unit
     {
-      const aiMesh* mesh = scene->mMeshes[0];
-
-      // Load the indices
-      indices.resize(static_cast<size_t>(mesh->mNumFaces) * 3u);
-      for (unsigned int i = 0u; i < mesh->mNumFaces; ++i)
+      const GLint location = glGetUniformLocation(program, "bonePalette");
+      if (location < 0)
       {
-        const aiFace& face = mesh->mFaces[i];
-        assert(face.mNumIndices == 3u);
-        indices.at(static_cast<size_t>(i) * 3u + 0u) = face.mIndices[0];
-        indices.at(static_cast<size_t>(i) * 3u + 1u) = face.mIndices[1];
-        indices.at(static_cast<size_t>(i) * 3u + 2u) = face.mIndices[2];
+        std::cerr << "Failed to get bone palette uniform location";
+        return false;
       }
 
-      // Load the vertices
-      vertices.resize(static_cast<size_t>(mesh->mNumVertices));
-      for (unsigned int i = 0u; i < mesh->mNumVertices; ++i)
-      {
-        Vertex& vertex = vertices.at(i);
-
-        // Position
-        {
-          const aiVector3D& position = mesh->mVertices[i];
-          vertex.position = glm::vec3(position.x, position.y, position.z);
-        }
-
-        // Normal
-        {
-          const aiVector3D& normal = mesh->mNormals[i];
-          vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
-        }
+      glUniform1i(location, 0);
+    }
 
-        // These will be set in the next step
-        vertices.at(i).boneIds = glm::ivec4(-1);
-        vertices.at(i).boneWeights = glm::vec4(0.0f);
+    // Set projection matrix
+    {
+      const GLint location = glGetUniformLocation(program, "projection");
+      if (location < 0)
+      {
+        std::cerr << "Failed to get projection matrix uniform location";
+        return false;
       }
 
-      // Load the bones
-      bones.resize(mesh->mNumBones);
-      boneTransforms.resize(mesh->mNumBones);
-      for (unsigned int i = 0u; i < mesh->mNumBones; ++i)
+      const glm::mat4 projectionMatrix = glm::perspective(cameraFov, windowAspectRatio, cameraNear, cameraFar);
+      glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    }
+
+    // Set color
+    {
+      const GLint location = glGetUniformLocation(program, "color");
+      if (location < 0)
       {
-        const aiBone* boneInfo = mesh->mBones[i];
+        std::cerr << "Failed to get color uniform location";
+        return false;
+      }
 
-        // Store the inverse bind matrix for this bone
-        bones.at(i).inverseBindMatrix = assimpToGlmMat4(boneInfo->mOffsetMatrix);
+      const glm::vec4 color = glm::vec4(geometryColor.r, geometryColor.g, geometryColor.b, geometryColor.a);
+      glUniform4fv(location, 1, glm::value_ptr(color));
+    }
+  }
 
-        // Iterate through all the vertices that this bone affects
-        for (unsigned int j = 0u; j < boneInfo->mNumWeights; ++j)
-        {
-          const aiVertexWeight& weight = boneInfo->mWeights[j];
-          Vertex& affectedVertex = vertices.at(weight.mVertexId);
+  return true;
+}
 
-          // Find the first unpopulated element for this vertex
-          unsigned int element = 0u;
-          while (element < 3u)
-          {
-            if (affectedVertex.boneIds[element] < 0)
-            {
-              break;
-            }
-            ++element;
-          }
+} // namespace
 
-          // Mark this vertex as being affected by the bone
-          affectedVertex.boneIds[element] = i;
-          affectedVertex.boneWeights[element] = weight.mWeight;
-        }
-      }
+int main(int argc, char* argv[])
+{
+  // Load another model file or a synthetic model (see Synthetic.h) if requested, the option is removed from the
+  // arguments so that the benchmarks still find theirs in place
+  const char* modelFileName = defaultModelFileName;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--model") == 0)
+    {
+      modelFileName = argv[i + 1];
+      std::copy(argv + i + 2, argv + argc + 1, argv + i); // Including the null pointer that ends the arguments
+      argc -= 2;
+      break;
     }
+  }
 
-    // Load the first animation
-    {
-      const aiAnimation* animation = scene->mAnimations[0];
+  // Run a benchmark instead of the viewer if requested, the frame benchmark needs neither a window nor OpenGL while the
+  // palette benchmark needs OpenGL but no visible window, the other benchmarks are part of poser_bench
+  if (argc > 1 && std::strcmp(argv[1], "--bench") == 0)
+  {
+    const int frameCount = argc > 2 ? std::max(std::atoi(argv[2]), 1) : defaultBenchmarkFrameCount;
+    const int instanceCount = argc > 3 ? std::max(std::atoi(argv[3]), 1) : defaultBenchmarkInstanceCount;
+    const unsigned int threadCount =
+      argc > 4 ? static_cast<unsigned int>(std::max(std::atoi(argv[4]), 1)) : std::thread::hardware_concurrency();
+    return benchmarkFrames(modelFileName, frameCount, instanceCount, threadCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-      // Load the keyframes for each bone
-      for (unsigned int i = 0u; i < animation->mNumChannels; ++i)
-      {
-        const aiNodeAnim* channel = animation->mChannels[i];
+  if (argc > 1 && std::strcmp(argv[1], "--bench-palette") == 0)
+  {
+    return benchmarkPaletteUpload(modelFileName) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-        const int boneIndex = findNamedBone(scene, channel->mNodeName);
-        if (boneIndex < 0)
-        {
-          continue;
-        }
+  // Animate a crowd of instances instead of a single one, skin with dual quaternions, simulate at another rate and
+  // write a trace of the profiled scopes on exit if requested
+  int crowdSize = 1;
+  poser::SkinningMode skinningMode = poser::SkinningMode::LinearBlend;
+  double simulationRate = defaultSimulationRate;
+  const char* traceFileName = nullptr;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 < argc && std::strcmp(argv[i], "--crowd") == 0)
+    {
+      crowdSize = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (std::strcmp(argv[i], "--dual-quaternion") == 0)
+    {
+      skinningMode = poser::SkinningMode::DualQuaternion;
+    }
+    else if (i + 1 < argc && std::strcmp(argv[i], "--simulation-rate") == 0)
+    {
+      simulationRate = std::max(std::atof(argv[++i]), 1.0);
+    }
+    else if (i + 1 < argc && std::strcmp(argv[i], "--trace") == 0)
+    {
+      traceFileName = argv[++i];
+    }
+  }
 
-        Bone& bone = bones.at(boneIndex);
+  // Create window and load OpenGL
+  GLFWwindow* window = createWindow(true);
+  if (!window)
+  {
+    return EXIT_FAILURE;
+  }
 
-        // Translation keyframes
-        {
-          bone.translationKeyframes.resize(channel->mNumPositionKeys);
-          for (unsigned int j = 0u; j < channel->mNumPositionKeys; ++j)
-          {
-            const aiVector3D& translation = channel->mPositionKeys[j].mValue;
-            bone.translationKeyframes.at(j) = glm::translate(glm::mat4(1.0f), glm::make_vec3(&translation.x));
-          }
-        }
+  // Set up input and render state
+  {
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetCursorPosCallback(window, cursorPositionCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetScrollCallback(window, scrollCallback);
 
-        // Rotation keyframes
-        {
-          bone.rotationKeyframes.resize(channel->mNumRotationKeys);
-          for (unsigned int j = 0u; j < channel->mNumRotationKeys; ++j)
-          {
-            const aiQuaternion& rotation = channel->mRotationKeys[j].mValue;
-            bone.rotationKeyframes.at(j) = glm::toMat4(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
-          }
-        }
+    glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+    glEnable(GL_DEPTH_TEST);
+  }
 
-        // Scale keyframes
-        {
-          bone.scaleKeyframes.resize(channel->mNumScalingKeys);
-          for (unsigned int j = 0u; j < channel->mNumScalingKeys; ++j)
-          {
-            const aiVector3D& scale = channel->mScalingKeys[j].mValue;
-            bone.scaleKeyframes.at(j) = glm::scale(glm::mat4(1.0f), glm::make_vec3(&scale.x));
-          }
-        }
-      }
-    }
+  // Load a model
+  poser::Model model;
+  bool loadedFromCache;
+  if (!poser::loadModel(modelFileName, model, loadedFromCache))
+  {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
 
-    // Load the skeleton
-    loadSkeletonNode(scene, scene->mRootNode, nullptr);
+  // Each draw range is drawn with one draw call, usually one per influence count the submeshes use
+  const std::vector<poser::DrawRange> drawRanges = poser::getDrawRanges(model.mesh);
+  std::cout << "Model: " << modelFileName << " (" << model.mesh.submeshes.size() << " submeshes, "
+            << model.mesh.vertices.size() << " vertices, " << model.mesh.indices.size() / 3u << " triangles, "
+            << model.skeleton.bones.size() << " bones, " << model.mesh.influenceCount << " influences, "
+            << (loadedFromCache ? "loaded from cache" : "imported")
+            << ")\n";
+  std::cout << "Draw calls: " << drawRanges.size() << " per frame with "
+            << poser::getIndexFormatName(model.mesh.indexFormat) << " indices\n";
+  std::cout << "Clips: " << model.clips.getClipCount() << ", playing " << model.clips.getClipName(0u)
+            << " (switch with the left and right arrow keys)\n";
+
+  std::vector<poser::Instance> instances = poser::createInstances(model, crowdSize);
+  poser::ThreadPool threadPool(std::thread::hardware_concurrency());
+  size_t playingClipIndex = 0u;
+  double crossfadeStart = 0.0; // In simulation seconds
+
+  // Pose the first step twice so that the first frames have a previous pose to interpolate from
+  std::cout << "Simulation: " << simulationRate << " steps per second\n";
+  poser::FixedTimestep timestep(simulationRate);
+  for (int i = 0; i < 2; ++i)
+  {
+    poser::updateAnimations(threadPool, model, instances, 0.0, skinningMode);
+  }
+
+  const size_t boneCount = model.skeleton.bones.size();
+  if (!isBonePaletteSupported(instances.size(), boneCount, skinningMode))
+  {
+    glfwTerminate();
+    return EXIT_FAILURE;
   }
 
   // Set up geometry
+  const GLenum indexType = model.mesh.indexFormat == poser::IndexFormat::Index16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
   {
+    POSER_PROFILE_SCOPE("Upload geometry");
+
     // Generate and bind a vertex array to capture the following vertex and index buffer
     {
       GLuint vertexArray;
@@ -360,230 +764,209 @@ int main()
       glBindVertexArray(vertexArray);
     }
 
-    // Generate and fill an index buffer
+    // Generate and fill an index buffer with the indices in the index format
     {
       GLuint indexBuffer;
       glGenBuffers(1, &indexBuffer);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(unsigned int) * indices.size()),
-                   indices.data(), GL_STATIC_DRAW);
+      if (model.mesh.indexFormat == poser::IndexFormat::Index16)
+      {
+        const std::vector<uint16_t>& indices = model.mesh.packedIndices16;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(uint16_t) * indices.size()),
+                     indices.data(), GL_STATIC_DRAW);
+      }
+      else
+      {
+        const std::vector<unsigned int>& indices = model.mesh.indices;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(unsigned int) * indices.size()),
+                     indices.data(), GL_STATIC_DRAW);
+      }
     }
 
-    // Generate and fill a vertex buffer
+    // Generate and fill a vertex buffer with the packed vertices and apply their definition
+    if (model.mesh.vertexFormat == poser::VertexFormat::Packed16)
     {
-      GLuint vertexBuffer;
-      glGenBuffers(1, &vertexBuffer);
-      glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-      glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(Vertex) * vertices.size()), vertices.data(),
-                   GL_STATIC_DRAW);
+      uploadPackedVertices(model.mesh.packedVertices16, GL_UNSIGNED_SHORT);
     }
-
-    // Apply the vertex definition
+    else
     {
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            reinterpret_cast<void*>(offsetof(Vertex, position)));
-
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            reinterpret_cast<void*>(offsetof(Vertex, normal)));
-
-      glEnableVertexAttribArray(2);
-      glVertexAttribIPointer(2, 4, GL_INT, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, boneIds)));
-
-      glEnableVertexAttribArray(3);
-      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            reinterpret_cast<void*>(offsetof(Vertex, boneWeights)));
+      uploadPackedVertices(model.mesh.packedVertices8, GL_UNSIGNED_BYTE);
     }
-  }
 
-  // Set up a shader program
-  GLint viewUniformLocation, boneTransformsUniformLocation;
-  {
-    // Compile the vertex shader
-    GLuint vertexShader;
+    // Generate and fill an instance buffer, each instance finds its bone transforms in the bone palette by offset
     {
-      vertexShader = glCreateShader(GL_VERTEX_SHADER);
-
-      const GLchar* source = R"(#version 330 core
-                                uniform mat4 view;
-                                uniform mat4 projection;
-                                uniform mat4 boneTransforms[64];
-                                layout(location = 0) in vec3 inPosition;
-                                layout(location = 1) in vec3 inNormal;
-                                layout(location = 2) in ivec4 inBoneIds;
-                                layout(location = 3) in vec4 inBoneWeights;
-                                out vec3 normal;
-                                void main()
-                                {
-                                  mat4 boneTransform = mat4(0.0);
-                                  for (int i = 0; i < 4; ++i)
-                                  {
-                                    boneTransform += boneTransforms[inBoneIds[i]] * inBoneWeights[i];
-                                  }
-                                  gl_Position = projection * view * boneTransform * vec4(inPosition, 1.0);
-                                  normal = normalize((boneTransform * vec4(inNormal, 0.0)).xyz);
-                                })";
-
-      glShaderSource(vertexShader, 1, &source, nullptr);
-      glCompileShader(vertexShader);
-
-      GLint success;
-      glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-      if (!success)
+      std::vector<InstanceAttributes> instanceAttributes(instances.size());
+      for (size_t i = 0u; i < instances.size(); ++i)
       {
-        GLchar infoLog[shaderInfoLogLength];
-        glGetShaderInfoLog(vertexShader, shaderInfoLogLength, nullptr, infoLog);
-        std::cerr << "Failed to compile vertex shader:\n" << infoLog;
-        glfwTerminate();
-        return EXIT_FAILURE;
+        instanceAttributes.at(i).position = instances.at(i).position;
+        instanceAttributes.at(i).paletteOffset = static_cast<GLint>(i * boneCount);
       }
-    }
-
-    // Compile the fragment shader
-    GLuint fragmentShader;
-    {
-      fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
-      const GLchar* source = R"(#version 150 core
-                                uniform vec4 color;
-                                in vec3 normal;
-                                out vec4 fragColor;
-                                void main()
-                                {
-                                  float diffuse = dot(normal, vec3(1.0));
-                                  fragColor = vec4(color.rgb * diffuse, color.a);
-                                })";
-
-      glShaderSource(fragmentShader, 1, &source, nullptr);
-      glCompileShader(fragmentShader);
-
-      GLint success;
-      glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-      if (!success)
-      {
-        GLchar infoLog[shaderInfoLogLength];
-        glGetShaderInfoLog(fragmentShader, shaderInfoLogLength, nullptr, infoLog);
-        std::cerr << "Failed to compile fragment shader:\n" << infoLog;
-        glfwTerminate();
-        return EXIT_FAILURE;
-      }
+      GLuint instanceBuffer;
+      glGenBuffers(1, &instanceBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+      glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(InstanceAttributes) * instanceAttributes.size()),
+                   instanceAttributes.data(), GL_STATIC_DRAW);
     }
 
-    // Link shader program
-    GLuint program;
+    // Apply the instance definition
     {
-      program = glCreateProgram();
-
-      glAttachShader(program, vertexShader);
-      glAttachShader(program, fragmentShader);
+      glEnableVertexAttribArray(4);
+      glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes),
+                            reinterpret_cast<void*>(offsetof(InstanceAttributes, position)));
+      glVertexAttribDivisor(4, 1);
+
+      glEnableVertexAttribArray(5);
+      glVertexAttribIPointer(5, 1, GL_INT, sizeof(InstanceAttributes),
+                             reinterpret_cast<void*>(offsetof(InstanceAttributes, paletteOffset)));
+      glVertexAttribDivisor(5, 1);
+    }
+  }
 
-      glLinkProgram(program);
+  // Set up the bone palette, a texture buffer with the bone transforms of all instances that is refilled every frame
+  GLuint paletteBuffer;
+  {
+    glGenBuffers(1, &paletteBuffer);
+    uploadBonePalette(paletteBuffer, instances, model.skeleton, skinningMode, 0.0f);
+
+    GLuint paletteTexture;
+    glGenTextures(1, &paletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBuffer);
+  }
 
-      GLint success;
-      glGetProgramiv(program, GL_LINK_STATUS, &success);
-      if (!success)
+  // Set up a shader program for each influence count the draw ranges use, so that each draw range skins its vertices
+  // for no more influences than they have
+  GLuint programs[poser::maxInfluenceCount] = {};
+  GLint viewUniformLocations[poser::maxInfluenceCount] = {};
+  {
+    POSER_PROFILE_SCOPE("Set up shader programs");
+    for (const poser::DrawRange& drawRange : drawRanges)
+    {
+      const int influenceCount = static_cast<int>(drawRange.influenceCount);
+      if (programs[influenceCount - 1] == 0u &&
+          !createShaderProgram(skinningMode, influenceCount, programs[influenceCount - 1],
+                               viewUniformLocations[influenceCount - 1]))
       {
-        GLchar infoLog[shaderInfoLogLength];
-        glGetProgramInfoLog(program, shaderInfoLogLength, nullptr, infoLog);
-        std::cerr << "Failed to link shader program:\n" << infoLog;
         glfwTerminate();
         return EXIT_FAILURE;
       }
-
-      glDeleteShader(vertexShader);
-      glDeleteShader(fragmentShader);
     }
+  }
 
-    // Use shader program, retrieve uniform locations and set constant uniform values
+  // Main loop
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point startTime = Clock::now();
+  while (!glfwWindowShouldClose(window))
+  {
+    POSER_PROFILE_SCOPE("Frame");
+
+    // Update
     {
-      glUseProgram(program);
+      POSER_PROFILE_SCOPE("Update");
 
-      // Retrieve view matrix location
+      // Simulate the steps that are due at the fixed rate, however many frames are rendered in between
+      timestep.advance(std::chrono::duration<double>(Clock::now() - startTime).count(), maxSimulationStepsPerFrame);
+      double time;
+      while (timestep.step(time))
       {
-        viewUniformLocation = glGetUniformLocation(program, "view");
-        if (viewUniformLocation < 0)
-        {
-          std::cerr << "Failed to get view matrix uniform location";
-          glfwTerminate();
-          return EXIT_FAILURE;
-        }
-      }
+        POSER_PROFILE_SCOPE("Simulation step");
 
-      // Retrieve bone transforms location
-      {
-        boneTransformsUniformLocation = glGetUniformLocation(program, "boneTransforms");
-        if (boneTransformsUniformLocation < 0)
+        // Crossfade all instances to another clip, which is decoded on first use, by fading in a layer playing it
+        if (clipStep != 0)
         {
-          std::cerr << "Failed to get bone transforms uniform location";
-          glfwTerminate();
-          return EXIT_FAILURE;
+          const int clipCount = static_cast<int>(model.clips.getClipCount());
+          playingClipIndex = static_cast<size_t>(
+            ((static_cast<int>(playingClipIndex) + clipStep) % clipCount + clipCount) % clipCount);
+          for (poser::Instance& instance : instances)
+          {
+            poser::addLayer(instance, playingClipIndex, poser::BlendMode::Override, nullptr);
+          }
+          crossfadeStart = time;
+          std::cout << "Playing " << model.clips.getClipName(playingClipIndex) << " ("
+                    << model.clips.getClipDuration(playingClipIndex) << " s)\n";
+          clipStep = 0;
         }
-      }
 
-      // Set projection matrix
-      {
-        const GLint location = glGetUniformLocation(program, "projection");
-        if (location < 0)
+        // Once the crossfade completes the clip faded in hides all others, so it becomes the clip of the instances
+        const float crossfadeWeight = static_cast<float>(std::min((time - crossfadeStart) / crossfadeDuration, 1.0));
+        for (poser::Instance& instance : instances)
         {
-          std::cerr << "Failed to get projection matrix uniform location";
-          glfwTerminate();
-          return EXIT_FAILURE;
-        }
-
-        const glm::mat4 projectionMatrix = glm::perspective(cameraFov, windowAspectRatio, cameraNear, cameraFar);
-        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-      }
-
-      // Set color
-      {
-        const GLint location = glGetUniformLocation(program, "color");
-        if (location < 0)
-        {
-          std::cerr << "Failed to get color uniform location";
-          glfwTerminate();
-          return EXIT_FAILURE;
+          if (!instance.layers.empty())
+          {
+            instance.layers.back().weight = crossfadeWeight;
+            if (crossfadeWeight >= 1.0f)
+            {
+              poser::promoteLayer(instance, instance.layers.size() - 1u);
+            }
+          }
         }
 
-        const glm::vec4 color = glm::vec4(geometryColor.r, geometryColor.g, geometryColor.b, geometryColor.a);
-        glUniform4fv(location, 1, glm::value_ptr(color));
+        poser::updateAnimations(threadPool, model, instances, time, skinningMode);
       }
-    }
-  }
 
-  // Main loop
-  while (!glfwWindowShouldClose(window))
-  {
-    // Update
-    {
-      ++frameIndex;
-      updateAnimation();
+      // Render between the last two steps, which shows the animation a step late but moves it smoothly every frame
+      uploadBonePalette(paletteBuffer, instances, model.skeleton, skinningMode, timestep.getInterpolationFactor());
     }
 
     // Render
     {
+      POSER_PROFILE_SCOPE("Render");
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-      // Set view matrix uniform
+      // Set view matrix uniform of each shader program
       {
         glm::mat4 viewMatrix = glm::lookAt(glm::vec3(glm::sin(cameraAngle) * cameraDistance, cameraPositionY,
                                                      glm::cos(cameraAngle) * cameraDistance),
                                            glm::vec3(0.0f, cameraTargetY, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(viewUniformLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+        for (int i = 0; i < poser::maxInfluenceCount; ++i)
+        {
+          if (programs[i] != 0u)
+          {
+            glUseProgram(programs[i]);
+            glUniformMatrix4fv(viewUniformLocations[i], 1, GL_FALSE, glm::value_ptr(viewMatrix));
+          }
+        }
       }
 
-      // Set bone transforms uniform
-      glUniformMatrix4fv(boneTransformsUniformLocation, static_cast<GLsizei>(boneTransforms.size()), GL_FALSE,
-                         glm::value_ptr(boneTransforms[0]));
-
-      glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+      // Draw all instances at once, one draw range at a time with the shader program for its influence count
+      {
+        POSER_PROFILE_SCOPE("Draw");
+        for (const poser::DrawRange& drawRange : drawRanges)
+        {
+          glUseProgram(programs[drawRange.influenceCount - 1u]);
+          const size_t indexOffset = getIndexSize(model.mesh.indexFormat) * drawRange.firstIndex;
+          glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(drawRange.indexCount), indexType,
+                                            reinterpret_cast<void*>(indexOffset),
+                                            static_cast<GLsizei>(instances.size()),
+                                            static_cast<GLint>(drawRange.baseVertex));
+        }
+      }
 
-      glfwSwapBuffers(window);
+      // Present the frame, which waits for the GPU and for vertical sync
+      {
+        POSER_PROFILE_SCOPE("Swap buffers");
+        glfwSwapBuffers(window);
+      }
     }
 
-    glfwPollEvents();
+    {
+      POSER_PROFILE_SCOPE("Poll events");
+      glfwPollEvents();
+    }
   }
 
   glfwTerminate();
+
+  // Report where the time went
+  if (poser::isProfilerEnabled())
+  {
+    poser::printProfileStats(std::cout);
+    if (traceFileName && !poser::writeChromeTrace(traceFileName))
+    {
+      return EXIT_FAILURE;
+    }
+  }
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Bones affecting a vertex at most, set by the build (4 or 8)
+#if !defined(POSER_MAX_INFLUENCE_COUNT)
+  #define POSER_MAX_INFLUENCE_COUNT 4
+#endif
+
+namespace poser
+{
+
+// Skinning constants
+constexpr int maxInfluenceCount = POSER_MAX_INFLUENCE_COUNT; // The import keeps the largest weights of each vertex
+static_assert(maxInfluenceCount == 4 || maxInfluenceCount == 8, "Vertices hold either 4 or 8 influences");
+
+// Vertex definition
+struct Vertex
+{
+  glm::vec3 position, normal;
+  int boneIds[maxInfluenceCount];       // Which bones affect this vertex (indices into the bone and bone transform
+                                        // array), -1 for missing bones, which come last
+  float boneWeights[maxInfluenceCount]; // How much each indexed bone affects this vertex, from largest to smallest,
+                                        // elements sum up to 1.0
+};
+
+// Packed vertex definition, the vertex quantized for rendering and skinning, the position stays full precision, the
+// normal is octahedral encoded into two signed normalized 16-bit integers and the bone ids and weights (unsigned
+// normalized) use the smallest unsigned integers that fit the bone count
+template<typename Component>
+struct PackedVertex
+{
+  glm::vec3 position;
+  int16_t normal[2];
+  Component boneIds[maxInfluenceCount];     // Missing bones have an id and a weight of zero
+  Component boneWeights[maxInfluenceCount]; // Elements sum up to the largest value of the component
+};
+
+using PackedVertex8 = PackedVertex<uint8_t>;   // Up to 256 bones
+using PackedVertex16 = PackedVertex<uint16_t>; // Up to 65536 bones
+
+// How the vertices of a mesh are packed
+enum class VertexFormat : uint32_t
+{
+  Packed8,
+  Packed16
+};
+
+// How the indices of a mesh are packed
+enum class IndexFormat : uint32_t
+{
+  Index16,
+  Index32
+};
+
+// Part of a mesh imported from a separate mesh of the file, its indices are relative to its base vertex, consecutive
+// submeshes share their base vertex where their vertices fit the range of 16-bit indices together, the import splits
+// each one by the influence count of its triangles
+struct Submesh
+{
+  uint32_t firstIndex, indexCount;
+  uint32_t baseVertex;
+  uint32_t influenceCount; // Bones affecting each vertex of its triangles at most
+};
+
+// Part of a mesh that a single draw call covers, consecutive submeshes sharing their base vertex and influence count
+struct DrawRange
+{
+  uint32_t firstIndex, indexCount;
+  uint32_t baseVertex, vertexCount;
+  uint32_t influenceCount; // Selects the variant of the vertex shader
+};
+
+// Consecutive vertices of a mesh affected by the same number of bones, which each get skinned with kernels specialized
+// for that number
+struct InfluenceRange
+{
+  uint32_t firstVertex, vertexCount;
+  int influenceCount;
+};
+
+// Mesh definition, indexed triangle lists skinned to a skeleton, all submeshes share the vertices and indices, which
+// are also packed in the vertex and index format for rendering and skinning
+struct Mesh
+{
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices; // Relative to the base vertex of their submesh
+  std::vector<Submesh> submeshes;
+  int influenceCount = 1; // Bones affecting a vertex at most in this mesh, which skinning is specialized for
+  VertexFormat vertexFormat = VertexFormat::Packed8;
+  std::vector<PackedVertex8> packedVertices8;   // Only filled for the 8-bit vertex format
+  std::vector<PackedVertex16> packedVertices16; // Only filled for the 16-bit vertex format
+  IndexFormat indexFormat = IndexFormat::Index32;
+  std::vector<uint16_t> packedIndices16; // Only filled for the 16-bit index format, otherwise the indices are used
+};
+
+} // namespace poser
@@ -0,0 +1,399 @@
+#include "MeshOptimization.h"
+
+#include "Profiler.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace poser
+{
+
+namespace
+{
+
+// Vertex cache optimization constants, from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr size_t scoredCacheSize = 32u; // Vertices further back in the cache score like vertices outside of it
+constexpr float cacheDecayPower = 1.5f;
+constexpr float lastTriangleScore = 0.75f; // Slightly penalizes the vertices of the last triangle to avoid strips
+constexpr float valenceBoostScale = 2.0f;  // Favors vertices with few triangles left so that they do not linger
+constexpr float valenceBoostPower = 0.5f;
+
+// Overdraw optimization constants
+constexpr size_t overdrawCacheSize = 16u; // Cache size the clusters are split for
+constexpr float defaultOverdrawThreshold = 1.05f;
+
+// FIFO post-transform vertex cache, each vertex remembers when it was last transformed so that the vertex is in the
+// cache while fewer than size vertices were transformed since
+class FifoVertexCache
+{
+public:
+  FifoVertexCache(size_t vertexCount, size_t size) : timestamps(vertexCount, 0u), size(size), time(size + 1u) {}
+
+  // Returns true if the vertex missed the cache and had to be transformed
+  bool access(unsigned int vertex)
+  {
+    if (time - timestamps.at(vertex) <= size)
+    {
+      return false;
+    }
+    timestamps.at(vertex) = time++;
+    return true;
+  }
+
+  // Returns the number of the vertices of the triangle that missed the cache
+  unsigned int accessTriangle(const unsigned int* triangle)
+  {
+    return static_cast<unsigned int>(access(triangle[0])) + static_cast<unsigned int>(access(triangle[1])) +
+           static_cast<unsigned int>(access(triangle[2]));
+  }
+
+  void clear()
+  {
+    time += size;
+  }
+
+private:
+  std::vector<size_t> timestamps;
+  size_t size, time;
+};
+
+float getVertexScore(int cachePosition, unsigned int remainingValence)
+{
+  // Vertices without triangles left must never be picked
+  if (remainingValence == 0u)
+  {
+    return -1.0f;
+  }
+
+  float score = 0.0f;
+  if (cachePosition >= 0)
+  {
+    if (cachePosition < 3)
+    {
+      score = lastTriangleScore;
+    }
+    else
+    {
+      const float scale = 1.0f / static_cast<float>(scoredCacheSize - 3u);
+      score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scale, cacheDecayPower);
+    }
+  }
+  return score + valenceBoostScale * std::pow(static_cast<float>(remainingValence), -valenceBoostPower);
+}
+
+} // namespace
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices,
+                                         size_t vertexCount,
+                                         size_t cacheSize)
+{
+  assert(indices.size() % 3u == 0u);
+  FifoVertexCache cache(vertexCount, cacheSize);
+  size_t transformedVertexCount = 0u;
+  for (size_t i = 0u; i < indices.size(); i += 3u)
+  {
+    transformedVertexCount += cache.accessTriangle(&indices.at(i));
+  }
+
+  const float triangleCount = static_cast<float>(indices.size() / 3u);
+  return { triangleCount > 0.0f ? static_cast<float>(transformedVertexCount) / triangleCount : 0.0f,
+           vertexCount > 0u ? static_cast<float>(transformedVertexCount) / static_cast<float>(vertexCount) : 0.0f };
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+  assert(indices.size() % 3u == 0u);
+  const size_t triangleCount = indices.size() / 3u;
+
+  // List the triangles of each vertex, the triangles not emitted yet come first and number the remaining valence
+  std::vector<unsigned int> adjacencyOffsets(vertexCount + 1u, 0u);
+  for (const unsigned int index : indices)
+  {
+    ++adjacencyOffsets.at(index + 1u);
+  }
+  std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+  std::vector<unsigned int> adjacentTriangles(indices.size());
+  std::vector<unsigned int> remainingValences(vertexCount, 0u);
+  for (size_t i = 0u; i < indices.size(); ++i)
+  {
+    const unsigned int vertex = indices[i];
+    adjacentTriangles.at(adjacencyOffsets[vertex] + remainingValences[vertex]++) = static_cast<unsigned int>(i / 3u);
+  }
+
+  // Score the vertices, none of which are in the cache yet, a triangle scores the sum of its vertices
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t i = 0u; i < vertexCount; ++i)
+  {
+    vertexScores[i] = getVertexScore(-1, remainingValences[i]);
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<unsigned int> cache, nextCache;
+  cache.reserve(scoredCacheSize + 3u);
+  nextCache.reserve(scoredCacheSize + 3u);
+
+  std::vector<unsigned int> optimizedIndices;
+  optimizedIndices.reserve(indices.size());
+  size_t nextTriangle = 0u; // Every triangle before it has been emitted
+  size_t bestTriangle = triangleCount;
+  while (optimizedIndices.size() < indices.size())
+  {
+    // Continue with the next triangle in the original order if no triangle around the cache is left, a full search
+    // for the best triangle would make the optimization quadratic for little gain
+    if (bestTriangle == triangleCount)
+    {
+      while (emitted[nextTriangle])
+      {
+        ++nextTriangle;
+      }
+      bestTriangle = nextTriangle;
+    }
+
+    // Emit the triangle and remove it from the triangles of its vertices
+    const unsigned int* triangle = &indices[bestTriangle * 3u];
+    optimizedIndices.insert(optimizedIndices.end(), triangle, triangle + 3);
+    emitted[bestTriangle] = true;
+    for (int corner = 0; corner < 3; ++corner)
+    {
+      const unsigned int vertex = triangle[corner];
+      unsigned int* begin = adjacentTriangles.data() + adjacencyOffsets[vertex];
+      unsigned int* end = begin + remainingValences[vertex];
+      std::iter_swap(std::find(begin, end, static_cast<unsigned int>(bestTriangle)), end - 1);
+      --remainingValences[vertex];
+    }
+
+    // Move the vertices of the triangle to the front of the cache, the vertices pushed past its end leave it
+    nextCache.assign(triangle, triangle + 3);
+    for (const unsigned int vertex : cache)
+    {
+      if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+      {
+        nextCache.push_back(vertex);
+      }
+    }
+
+    for (size_t i = 0u; i < nextCache.size(); ++i)
+    {
+      const unsigned int vertex = nextCache[i];
+      const int cachePosition = i < scoredCacheSize ? static_cast<int>(i) : -1;
+      vertexScores[vertex] = getVertexScore(cachePosition, remainingValences[vertex]);
+    }
+
+    // Rescore the triangles around the vertices that moved and continue with the best of them
+    bestTriangle = triangleCount;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (const unsigned int vertex : nextCache)
+    {
+      const unsigned int* begin = adjacentTriangles.data() + adjacencyOffsets[vertex];
+      for (const unsigned int* adjacentTriangle = begin; adjacentTriangle != begin + remainingValences[vertex];
+           ++adjacentTriangle)
+      {
+        const unsigned int* corners = &indices[*adjacentTriangle * 3u];
+        const float score = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+        if (score > bestScore)
+        {
+          bestScore = score;
+          bestTriangle = *adjacentTriangle;
+        }
+      }
+    }
+
+    nextCache.resize(std::min(nextCache.size(), scoredCacheSize));
+    std::swap(cache, nextCache);
+  }
+
+  indices.swap(optimizedIndices);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+  assert(indices.size() % 3u == 0u);
+  const size_t triangleCount = indices.size() / 3u;
+  if (triangleCount == 0u)
+  {
+    return;
+  }
+
+  // Split the triangles where all vertices of a triangle miss the cache, which is where the vertex cache optimization
+  // had to start over somewhere else, so that the clusters can be drawn in any order without losing locality
+  std::vector<size_t> hardBoundaries;
+  {
+    FifoVertexCache cache(vertices.size(), overdrawCacheSize);
+    for (size_t i = 0u; i < triangleCount; ++i)
+    {
+      if (cache.accessTriangle(&indices[i * 3u]) == 3u || i == 0u)
+      {
+        hardBoundaries.push_back(i);
+      }
+    }
+    hardBoundaries.push_back(triangleCount);
+  }
+
+  // Split those clusters further as long as each part keeps its cache miss ratio within the threshold of the whole
+  std::vector<size_t> boundaries;
+  {
+    FifoVertexCache cache(vertices.size(), overdrawCacheSize);
+    for (size_t cluster = 0u; cluster + 1u < hardBoundaries.size(); ++cluster)
+    {
+      const size_t begin = hardBoundaries[cluster], end = hardBoundaries[cluster + 1u];
+
+      cache.clear();
+      size_t clusterMisses = 0u;
+      for (size_t i = begin; i < end; ++i)
+      {
+        clusterMisses += cache.accessTriangle(&indices[i * 3u]);
+      }
+      const float maxAcmr = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+      cache.clear();
+      size_t start = begin, misses = 0u;
+      boundaries.push_back(begin);
+      for (size_t i = begin; i + 1u < end; ++i)
+      {
+        misses += cache.accessTriangle(&indices[i * 3u]);
+        if (static_cast<float>(misses) <= maxAcmr * static_cast<float>(i + 1u - start))
+        {
+          boundaries.push_back(i + 1u);
+          start = i + 1u;
+          misses = 0u;
+          cache.clear();
+        }
+      }
+    }
+    boundaries.push_back(triangleCount);
+  }
+
+  // Sort the clusters by how far they face away from the center of the mesh, the area weighted centroid and normal of
+  // a cluster stand in for its triangles
+  const auto getTriangleCentroid = [&](size_t triangle)
+  {
+    return (vertices.at(indices[triangle * 3u]).position + vertices.at(indices[triangle * 3u + 1u]).position +
+            vertices.at(indices[triangle * 3u + 2u]).position) /
+           3.0f;
+  };
+  const auto getTriangleAreaNormal = [&](size_t triangle)
+  {
+    const glm::vec3& a = vertices.at(indices[triangle * 3u]).position;
+    return glm::cross(vertices.at(indices[triangle * 3u + 1u]).position - a,
+                      vertices.at(indices[triangle * 3u + 2u]).position - a);
+  };
+
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  for (size_t i = 0u; i < triangleCount; ++i)
+  {
+    const float area = glm::length(getTriangleAreaNormal(i));
+    meshCentroid += getTriangleCentroid(i) * area;
+    meshArea += area;
+  }
+  meshCentroid /= std::max(meshArea, std::numeric_limits<float>::min());
+
+  const size_t clusterCount = boundaries.size() - 1u;
+  std::vector<float> clusterSortKeys(clusterCount);
+  for (size_t cluster = 0u; cluster < clusterCount; ++cluster)
+  {
+    glm::vec3 centroid(0.0f), normal(0.0f);
+    float area = 0.0f;
+    for (size_t i = boundaries[cluster]; i < boundaries[cluster + 1u]; ++i)
+    {
+      const glm::vec3 areaNormal = getTriangleAreaNormal(i);
+      const float triangleArea = glm::length(areaNormal);
+      centroid += getTriangleCentroid(i) * triangleArea;
+      normal += areaNormal;
+      area += triangleArea;
+    }
+
+    const float normalLength = glm::length(normal);
+    if (area > 0.0f && normalLength > 0.0f)
+    {
+      clusterSortKeys[cluster] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+  }
+
+  std::vector<size_t> clusterOrder(clusterCount);
+  std::iota(clusterOrder.begin(), clusterOrder.end(), size_t(0u));
+  std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+                   [&](size_t a, size_t b) { return clusterSortKeys[a] > clusterSortKeys[b]; });
+
+  std::vector<unsigned int> sortedIndices;
+  sortedIndices.reserve(indices.size());
+  for (const size_t cluster : clusterOrder)
+  {
+    sortedIndices.insert(sortedIndices.end(), indices.begin() + boundaries[cluster] * 3u,
+                         indices.begin() + boundaries[cluster + 1u] * 3u);
+  }
+  indices.swap(sortedIndices);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<Vertex>& vertices)
+{
+  constexpr unsigned int unused = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> remap(vertices.size(), unused);
+  std::vector<Vertex> fetchedVertices;
+  fetchedVertices.reserve(vertices.size());
+  for (unsigned int& index : indices)
+  {
+    if (remap.at(index) == unused)
+    {
+      remap[index] = static_cast<unsigned int>(fetchedVertices.size());
+      fetchedVertices.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(fetchedVertices);
+}
+
+void optimizeMesh(Mesh& mesh)
+{
+  POSER_PROFILE_SCOPE("Optimize mesh");
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  vertices.reserve(mesh.vertices.size());
+  indices.reserve(mesh.indices.size());
+
+  // Triangles stay within their submesh and vertices within their batch, which drops unused vertices and moves the
+  // following batches down, the draw ranges of a batch share its vertices so the fetch order follows their triangles
+  // within each influence count
+  for (size_t batchBegin = 0u, batchEnd = 0u; batchBegin < mesh.submeshes.size(); batchBegin = batchEnd)
+  {
+    const uint32_t baseVertex = mesh.submeshes.at(batchBegin).baseVertex;
+    while (batchEnd < mesh.submeshes.size() && mesh.submeshes.at(batchEnd).baseVertex == baseVertex)
+    {
+      ++batchEnd;
+    }
+    const size_t vertexEnd =
+      batchEnd < mesh.submeshes.size() ? mesh.submeshes.at(batchEnd).baseVertex : mesh.vertices.size();
+
+    std::vector<Vertex> batchVertices(mesh.vertices.begin() + baseVertex, mesh.vertices.begin() + vertexEnd);
+    std::vector<unsigned int> batchIndices;
+    for (size_t i = batchBegin; i < batchEnd; ++i)
+    {
+      const Submesh& submesh = mesh.submeshes.at(i);
+      std::vector<unsigned int> submeshIndices(mesh.indices.begin() + submesh.firstIndex,
+                                               mesh.indices.begin() + submesh.firstIndex + submesh.indexCount);
+      optimizeVertexCache(submeshIndices, batchVertices.size());
+      optimizeOverdraw(submeshIndices, batchVertices, defaultOverdrawThreshold);
+      batchIndices.insert(batchIndices.end(), submeshIndices.begin(), submeshIndices.end());
+    }
+    optimizeVertexFetch(batchIndices, batchVertices);
+    sortVerticesByInfluenceCount(batchIndices, batchVertices);
+
+    for (size_t i = batchBegin; i < batchEnd; ++i)
+    {
+      mesh.submeshes.at(i).baseVertex = static_cast<uint32_t>(vertices.size());
+    }
+    vertices.insert(vertices.end(), batchVertices.begin(), batchVertices.end());
+    indices.insert(indices.end(), batchIndices.begin(), batchIndices.end());
+  }
+
+  mesh.vertices = std::move(vertices);
+  mesh.indices = std::move(indices);
+}
+
+} // namespace poser
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace poser
+{
+
+// Post-transform vertex cache statistics of an index buffer, the average cache miss ratio is the number of transformed
+// vertices per triangle (3 at worst, around 0.5 at best for large regular meshes) and the average transformed vertex
+// ratio the number of transformed vertices per vertex (1 at best)
+struct VertexCacheStatistics
+{
+  float acmr, atvr;
+};
+
+// Simulates a FIFO post-transform vertex cache of the given size, like most GPUs have, drawing the triangles
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices,
+                                         size_t vertexCount,
+                                         size_t cacheSize);
+
+// Reorders the triangles so that consecutive triangles share vertices while they are still in the post-transform
+// vertex cache
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Splits the triangles into clusters that keep the vertex cache locality within the threshold (a factor of the average
+// cache miss ratio) and reorders the clusters so that those facing outwards are drawn first and occlude the others
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold);
+
+// Reorders the vertices in the order the triangles first use them so that fetching them walks memory linearly, drops
+// the vertices no triangle uses
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<Vertex>& vertices);
+
+// Optimizes the vertex cache locality, the overdraw and the vertex fetch locality of each submesh of the mesh in that
+// order, keeping the vertices of each batch ordered by influence count, must run after splitting the submeshes by
+// influence count and before packing the mesh
+void optimizeMesh(Mesh& mesh);
+
+} // namespace poser
@@ -0,0 +1,450 @@
+#include "Benchmark.h"
+#include "Import.h"
+#include "Kernel.h"
+#include "Model.h"
+#include "Pose.h"
+#include "Profiler.h"
+#include "Skinning.h"
+#include "Synthetic.h"
+#include "VertexPacking.h"
+
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// File constants
+constexpr char defaultModelFileName[] = "models/silly_dancing.fbx";
+
+// Benchmark constants
+constexpr int defaultBoneCount = 256;
+constexpr int defaultDepth = 64;
+constexpr int defaultVertexCount = 100000;
+constexpr int defaultInfluenceCount = 4;
+constexpr int defaultRepetitionCount = 10;
+constexpr double defaultTolerance = 0.1;      // Relative slowdown of the median that counts as a regression
+constexpr int warmUpRepetitionCount = 2;      // Untimed repetitions before the timed ones
+constexpr double minRepetitionSeconds = 0.02; // Repetitions run enough iterations to last at least this long
+constexpr double frameTime = 1.0 / 60.0;      // In seconds, between the samples of a clip
+constexpr int sceneBenchmarkVertexCount = 3;  // Of the scene of the import benchmark, which measures the clips
+
+// Benchmark settings definition, the parameters shared by all benchmarks
+struct Settings
+{
+  poser::SyntheticRig rig; // Of all generated data
+  int repetitionCount = defaultRepetitionCount;
+  const char* filter = nullptr;           // Only runs the benchmarks whose names contain this if set
+  const char* outputFileName = nullptr;   // Writes the results to the standard output if not set
+  const char* baselineFileName = nullptr; // Compares the results against the results in this file if set
+  double tolerance = defaultTolerance;
+};
+
+// Benchmark result definition, the time per iteration of each timed repetition of a benchmark
+struct Result
+{
+  std::string name;
+  std::vector<std::pair<const char*, int>> parameters;
+  int itemCount;      // Bones or vertices processed per iteration
+  int iterationCount; // Per repetition
+  std::vector<double> nanoseconds;
+};
+
+// Runs the function in repetitions of as many iterations as it takes to last the minimum repetition time, first to
+// warm up the caches and find the iteration count and then for the timed repetitions
+template<typename Function>
+Result measure(const Settings& settings, Function&& function)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Result result;
+  result.iterationCount = 1;
+  for (int repetition = -warmUpRepetitionCount; repetition < settings.repetitionCount; ++repetition)
+  {
+    const Clock::time_point start = Clock::now();
+    for (int iteration = 0; iteration < result.iterationCount; ++iteration)
+    {
+      function();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (repetition < 0)
+    {
+      // Grow the iteration count during the warm-up until a repetition lasts long enough, with some margin
+      const double scale = seconds > 0.0 ? minRepetitionSeconds / seconds * 1.2 : 2.0;
+      result.iterationCount = std::max(static_cast<int>(std::ceil(result.iterationCount * scale)),
+                                       result.iterationCount);
+    }
+    else
+    {
+      result.nanoseconds.push_back(seconds * 1.0e9 / result.iterationCount);
+    }
+  }
+  return result;
+}
+
+// Returns the key of the result in the output, its name and parameters, which a baseline result must match
+std::string getResultKey(const Result& result)
+{
+  std::string key = "\"name\": \"" + result.name + "\"";
+  for (const auto& [name, value] : result.parameters)
+  {
+    key += ", \"" + std::string(name) + "\": " + std::to_string(value);
+  }
+  return key;
+}
+
+// Writes the results as JSON with one benchmark per line, so that a baseline can be read back line by line
+void writeResults(std::ostream& stream, const Settings& settings, const std::vector<Result>& results)
+{
+  stream << "{\n";
+  stream << "  \"seed\": " << settings.rig.seed << ",\n";
+  stream << "  \"repetitions\": " << settings.repetitionCount << ",\n";
+  stream << "  \"kernel\": \"" << poser::getKernelName(poser::getKernels().back()) << "\",\n";
+  stream << "  \"benchmarks\": [\n";
+  for (size_t i = 0u; i < results.size(); ++i)
+  {
+    const Result& result = results.at(i);
+    std::vector<double> sorted = result.nanoseconds;
+    std::sort(sorted.begin(), sorted.end());
+
+    double mean = 0.0;
+    for (const double value : sorted)
+    {
+      mean += value;
+    }
+    mean /= static_cast<double>(sorted.size());
+
+    double variance = 0.0;
+    for (const double value : sorted)
+    {
+      variance += (value - mean) * (value - mean);
+    }
+    variance /= static_cast<double>(std::max(sorted.size(), size_t(2u)) - 1u);
+
+    const double median = poser::getPercentile(sorted, 50.0);
+    stream << "    { " << getResultKey(result) << ", \"iterations\": " << result.iterationCount
+           << ", \"medianNs\": " << median << ", \"meanNs\": " << mean << ", \"stddevNs\": " << std::sqrt(variance)
+           << ", \"minNs\": " << sorted.front() << ", \"maxNs\": " << sorted.back()
+           << ", \"itemsPerSecond\": " << result.itemCount * 1.0e9 / median << " }"
+           << (i + 1u < results.size() ? "," : "") << "\n";
+  }
+  stream << "  ]\n";
+  stream << "}\n";
+}
+
+// Compares the medians of the results against those of the baseline results with the same key, returns false if the
+// baseline cannot be read or any result is slower than the baseline by more than the tolerance
+bool compareResults(const Settings& settings, const std::vector<Result>& results)
+{
+  std::ifstream file(settings.baselineFileName);
+  if (!file)
+  {
+    std::cerr << "Failed to open baseline " << settings.baselineFileName << "\n";
+    return false;
+  }
+
+  // Each line with a benchmark holds its key up to the iterations and its median after the median label
+  std::map<std::string, double> baselineMedians;
+  constexpr char medianLabel[] = "\"medianNs\": ";
+  std::string line;
+  while (std::getline(file, line))
+  {
+    const size_t keyStart = line.find("\"name\"");
+    const size_t keyEnd = line.find(", \"iterations\"");
+    const size_t medianStart = line.find(medianLabel);
+    if (keyStart != std::string::npos && keyEnd != std::string::npos && medianStart != std::string::npos)
+    {
+      baselineMedians[line.substr(keyStart, keyEnd - keyStart)] =
+        std::atof(line.c_str() + medianStart + sizeof(medianLabel) - 1u);
+    }
+  }
+
+  bool withinTolerance = true;
+  for (const Result& result : results)
+  {
+    const std::string key = getResultKey(result);
+    const auto baseline = baselineMedians.find(key);
+    if (baseline == baselineMedians.end())
+    {
+      std::cerr << "No baseline for " << key << "\n";
+      continue;
+    }
+
+    std::vector<double> sorted = result.nanoseconds;
+    std::sort(sorted.begin(), sorted.end());
+    const double ratio = poser::getPercentile(sorted, 50.0) / baseline->second;
+    if (ratio > 1.0 + settings.tolerance)
+    {
+      std::cerr << "Regression: " << key << " takes " << ratio << "x the baseline\n";
+      withinTolerance = false;
+    }
+  }
+  return withinTolerance;
+}
+
+// Runs the benchmark if the filter selects it and adds its result
+template<typename Function>
+void run(const Settings& settings,
+         const char* name,
+         std::vector<std::pair<const char*, int>> parameters,
+         int itemCount,
+         std::vector<Result>& results,
+         Function&& function)
+{
+  if (settings.filter && !std::strstr(name, settings.filter))
+  {
+    return;
+  }
+
+  std::cerr << "Running " << name << "\n";
+  Result& result = results.emplace_back(measure(settings, function));
+  result.name = name;
+  result.parameters = std::move(parameters);
+  result.itemCount = itemCount;
+}
+
+// Runs all benchmarks the filter selects on data generated from the seed
+std::vector<Result> runBenchmarks(const Settings& settings)
+{
+  using namespace poser;
+
+  std::vector<Result> results;
+  std::mt19937 random(settings.rig.seed);
+
+  // The clips are measured on a scene with a minimal mesh and the mesh on a scene with minimal clips
+  SyntheticRig sceneRig = settings.rig, meshRig = settings.rig;
+  sceneRig.vertexCount = sceneBenchmarkVertexCount;
+  meshRig.keyframeRate = 0.0;
+  const std::unique_ptr<aiScene> scene = makeSyntheticScene(sceneRig), meshScene = makeSyntheticScene(meshRig);
+
+  Model model;
+  importScene(scene.get(), model);
+  const Clip& clip = model.clips.getClip(0u);
+  const int boneCount = static_cast<int>(model.skeleton.bones.size());
+  const int keyframeCount = static_cast<int>(clip.rotationKeyframes.size()) / boneCount;
+
+  // Keyframe sampling at advancing times from a random start, like an instance playing the clip
+  Pose pose;
+  pose.resize(model.skeleton.bones.size());
+  double time = std::uniform_real_distribution<double>(0.0, clip.duration)(random);
+  run(settings, "sampleClip", { { "bones", boneCount }, { "keyframes", keyframeCount } }, boneCount, results,
+      [&]
+      {
+        sampleClip(clip, time, pose.cursors, pose.localPose);
+        time += frameTime;
+      });
+
+  // Bone hierarchy pass from the sampled local pose
+  run(settings, "updateTransforms",
+      { { "bones", boneCount }, { "depth", settings.rig.depth }, { "branching", settings.rig.branchingFactor } },
+      boneCount, results, [&] { updateTransforms(model.skeleton, pose); });
+
+  // Palette construction, interpolating the affine bone transforms between two updates or converting them to dual
+  // quaternions
+  updatePose(model.skeleton, clip, time, pose);
+  pose.keepPreviousBoneTransforms();
+  updatePose(model.skeleton, clip, time + frameTime, pose);
+  std::vector<AffineTransform> affinePalette(pose.boneTransforms.size());
+  std::vector<DualQuaternion> dualQuaternionPalette(pose.boneTransforms.size());
+  run(settings, "paletteAffine", { { "bones", boneCount } }, boneCount, results,
+      [&] { interpolateBoneTransforms(model.skeleton, pose, 0.5f, affinePalette.data()); });
+  const auto convertPalette = [&]
+  {
+    std::transform(pose.boneTransforms.begin(), pose.boneTransforms.end(), dualQuaternionPalette.begin(),
+                   [](const AffineTransform& transform) { return toDualQuaternion(transform); });
+  };
+  run(settings, "paletteDualQuaternion", { { "bones", boneCount } }, boneCount, results, convertPalette);
+
+  // CPU skinning of random vertices with the widest kernels on a single thread, specialized for each influence range
+  Model meshModel;
+  importScene(meshScene.get(), meshModel);
+  const std::vector<Vertex>& vertices = meshModel.mesh.vertices;
+  const std::vector<InfluenceRange> influenceRanges = getInfluenceRanges(vertices);
+  const int vertexCount = static_cast<int>(vertices.size());
+  std::vector<SkinnedVertex> skinnedVertices(vertices.size());
+  const Kernel kernel = getKernels().back();
+  const std::vector<std::pair<const char*, int>> meshParameters = {
+    { "bones", boneCount },
+    { "vertices", vertexCount },
+    { "influences", meshModel.mesh.influenceCount },
+    { "rigidPercent", static_cast<int>(std::lround(settings.rig.rigidShare * 100.0)) }
+  };
+  const auto skinInfluenceRanges = [&](const auto& boneTransforms)
+  {
+    for (const InfluenceRange& range : influenceRanges)
+    {
+      skinVertices(vertices, boneTransforms, range.firstVertex, range.firstVertex + range.vertexCount,
+                   range.influenceCount, skinnedVertices, kernel);
+    }
+  };
+  convertPalette(); // The filter may have skipped the palette benchmarks
+  if (isPaletteComplete(pose.boneTransforms.size(), meshModel.skeleton.bones.size()))
+  {
+    run(settings, "skinLinearBlend", meshParameters, vertexCount, results,
+        [&] { skinInfluenceRanges(pose.boneTransforms); });
+    run(settings, "skinDualQuaternion", meshParameters, vertexCount, results,
+        [&] { skinInfluenceRanges(dualQuaternionPalette); });
+  }
+  else
+  {
+    std::cerr << "Skipping the skinning, " << pose.boneTransforms.size() << " bone transforms for "
+              << meshModel.skeleton.bones.size() << " bones\n";
+  }
+
+  // Import of the mesh alone, converting, optimizing and packing its vertices, and of the whole animated scene
+  run(settings, "importMesh", meshParameters, vertexCount, results,
+      [&]
+      {
+        Model importedModel;
+        importScene(meshScene.get(), importedModel);
+      });
+  run(settings, "importScene", { { "bones", boneCount }, { "keyframes", keyframeCount } }, boneCount,
+      results,
+      [&]
+      {
+        Model importedModel;
+        importScene(scene.get(), importedModel);
+      });
+
+  return results;
+}
+
+} // namespace
+
+// Microbenchmarks of the animation and import hot paths on generated data, for tracking their performance over time,
+// writes JSON results and optionally compares them against a stored baseline
+int main(int argc, char* argv[])
+{
+  // Run one of the benchmark modes on a model file or a synthetic model (see Synthetic.h) instead of the
+  // microbenchmarks if requested, the model option is removed from the arguments so that the mode finds its own in place
+  const char* modelFileName = defaultModelFileName;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--model") == 0)
+    {
+      modelFileName = argv[i + 1];
+      std::copy(argv + i + 2, argv + argc + 1, argv + i); // Including the null pointer that ends the arguments
+      argc -= 2;
+      break;
+    }
+  }
+
+  int exitCode;
+  if (poser::runBenchmark(argc, argv, modelFileName, exitCode))
+  {
+    return exitCode;
+  }
+
+  Settings settings;
+  settings.rig.boneCount = defaultBoneCount;
+  settings.rig.depth = defaultDepth;
+  settings.rig.vertexCount = defaultVertexCount;
+  settings.rig.influenceCount = defaultInfluenceCount;
+  for (int i = 1; i < argc; ++i)
+  {
+    const bool hasValue = i + 1 < argc;
+    if (hasValue && std::strcmp(argv[i], "--bones") == 0)
+    {
+      settings.rig.boneCount = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--depth") == 0)
+    {
+      settings.rig.depth = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--branching") == 0)
+    {
+      settings.rig.branchingFactor = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--vertices") == 0)
+    {
+      settings.rig.vertexCount = std::max(std::atoi(argv[++i]), 3);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--influences") == 0)
+    {
+      settings.rig.influenceCount = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--rigid") == 0)
+    {
+      settings.rig.rigidShare = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--duration") == 0)
+    {
+      settings.rig.clipDuration = std::max(std::atof(argv[++i]), 0.001);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--rate") == 0)
+    {
+      settings.rig.keyframeRate = std::max(std::atof(argv[++i]), 0.0);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--seed") == 0)
+    {
+      settings.rig.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else if (hasValue && std::strcmp(argv[i], "--repetitions") == 0)
+    {
+      settings.repetitionCount = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (hasValue && std::strcmp(argv[i], "--filter") == 0)
+    {
+      settings.filter = argv[++i];
+    }
+    else if (hasValue && std::strcmp(argv[i], "--output") == 0)
+    {
+      settings.outputFileName = argv[++i];
+    }
+    else if (hasValue && std::strcmp(argv[i], "--baseline") == 0)
+    {
+      settings.baselineFileName = argv[++i];
+    }
+    else if (hasValue && std::strcmp(argv[i], "--tolerance") == 0)
+    {
+      settings.tolerance = std::max(std::atof(argv[++i]), 0.0);
+    }
+    else
+    {
+      std::cerr << "Usage: " << argv[0]
+                << " [--bones count] [--depth depth] [--branching factor] [--vertices count] [--influences count]"
+                   " [--rigid share] [--duration seconds] [--rate keyframes per second] [--seed seed]"
+                   " [--repetitions count] [--filter name] [--output file] [--baseline file] [--tolerance ratio]\n"
+                << "   or: " << argv[0] << " --bench-<mode> [arguments] [--model file]\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  const std::vector<Result> results = runBenchmarks(settings);
+
+  if (settings.outputFileName)
+  {
+    std::ofstream file(settings.outputFileName);
+    writeResults(file, settings, results);
+    if (!file)
+    {
+      std::cerr << "Failed to write results to " << settings.outputFileName << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    writeResults(std::cout, settings, results);
+  }
+
+  if (settings.baselineFileName && !compareResults(settings, results))
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+#include "Model.h"
+
+#include "Cache.h"
+#include "Import.h"
+#include "Profiler.h"
+#include "Synthetic.h"
+
+namespace poser
+{
+
+bool loadModel(const char* fileName, Model& model, bool& loadedFromCache)
+{
+  POSER_PROFILE_SCOPE("Load model");
+
+  // Synthetic models have no file to keep a cache next to, so they are built on every load
+  const bool synthetic = isSyntheticModelName(fileName);
+  loadedFromCache = !synthetic && isCacheUpToDate(fileName) && loadCache(fileName, model);
+  if (loadedFromCache)
+  {
+    return true;
+  }
+
+  if (!importModel(fileName, model))
+  {
+    return false;
+  }
+
+  compressClips(model.skeleton, ClipCompressionSettings(), model.clips);
+
+  if (!synthetic)
+  {
+    saveCache(fileName, model); // Failing to write the cache only costs time on the next start
+  }
+  return true;
+}
+
+} // namespace poser
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ClipLibrary.h"
+#include "Mesh.h"
+#include "Skeleton.h"
+
+namespace poser
+{
+
+// Model definition, a mesh with the skeleton it is skinned to and the clips animating that skeleton
+struct Model
+{
+  Mesh mesh;
+  Skeleton skeleton;
+  ClipLibrary clips; // Always holds at least one clip
+};
+
+// Loads the model from its cache if that is up to date, otherwise imports it and (re)writes the cache, synthetic model
+// names (see Synthetic.h) build the model without a cache
+bool loadModel(const char* fileName, Model& model, bool& loadedFromCache);
+
+} // namespace poser
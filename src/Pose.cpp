@@ -0,0 +1,337 @@
+#include "Pose.h"
+
+#include "Blend.h"
+#include "Lanes.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace poser
+{
+
+namespace
+{
+
+// SIMD constants
+constexpr size_t maxSimdWidth = 8u; // Pose data is padded to a multiple of this many bones to suit any of the lanes
+
+// Returns the index of the last keyframe at or before the time in a track, starting the search at the cursor
+uint32_t findKeyframe(const float* times, uint32_t count, float time, uint32_t& cursor)
+{
+  // Fall back to a binary search when the time moved backwards, for example because the clip looped
+  if (cursor >= count || times[cursor] > time)
+  {
+    const uint32_t next = static_cast<uint32_t>(std::upper_bound(times, times + count, time) - times);
+    cursor = next > 0u ? next - 1u : 0u;
+  }
+
+  // Otherwise step forward, which only takes a step or two for sequential playback
+  while (cursor + 1u < count && times[cursor + 1u] <= time)
+  {
+    ++cursor;
+  }
+
+  return cursor;
+}
+
+// Keyframe samples definition, the two keyframes surrounding the sample time and the interpolation factor between them
+// for each track of each bone, keyframes are stored as float offsets into the keyframe arrays of the clip
+struct KeyframeSamples
+{
+  std::vector<int32_t> translationFrom, translationTo, rotationFrom, rotationTo, scaleFrom, scaleTo;
+  std::vector<float> translationFactor, rotationFactor, scaleFactor;
+};
+
+// Finds the surrounding keyframes and the interpolation factor of a track at the time in seconds, the keyframe stride
+// converts keyframe indices to float offsets
+void findKeyframes(const std::vector<float>& times,
+                   const Track& track,
+                   float time,
+                   int32_t keyframeStride,
+                   uint32_t& cursor,
+                   int32_t& from,
+                   int32_t& to,
+                   float& factor)
+{
+  const float* trackTimes = times.data() + track.first;
+  const uint32_t index = findKeyframe(trackTimes, track.count, time, cursor);
+  from = static_cast<int32_t>(track.first + index) * keyframeStride;
+
+  // Hold the first and last keyframes outside of the track
+  if (index + 1u >= track.count || time <= trackTimes[index])
+  {
+    to = from;
+    factor = 0.0f;
+    return;
+  }
+
+  to = from + keyframeStride;
+  factor = (time - trackTimes[index]) / (trackTimes[index + 1u] - trackTimes[index]);
+}
+
+// Interpolates the keyframe samples into the local pose, lerp for translation and scale and normalized lerp along the
+// shorter arc for rotation (keyframes are close enough together for this to be indistinguishable from slerp)
+template<typename Lanes>
+void interpolateKeyframes(const Clip& clip, const KeyframeSamples& samples, LocalPose& pose)
+{
+  for (size_t i = 0u; i < pose.translationX.size(); i += Lanes::width)
+  {
+    // Translation
+    {
+      const Lanes factor = Lanes::load(&samples.translationFactor[i]);
+      const float* base = &clip.translationKeyframes[0].x;
+      const int32_t* from = &samples.translationFrom[i];
+      const int32_t* to = &samples.translationTo[i];
+      for (int component = 0; component < 3; ++component)
+      {
+        const Lanes a = Lanes::gather(base + component, from), b = Lanes::gather(base + component, to);
+        (a + (b - a) * factor).store(&pose.translation(component)[i]);
+      }
+    }
+
+    // Rotation
+    {
+      const Lanes factor = Lanes::load(&samples.rotationFactor[i]);
+      const float* base = glm::value_ptr(clip.rotationKeyframes[0]);
+      Lanes a[4], b[4], rotation[4];
+      Lanes::gatherTransposed(base, &samples.rotationFrom[i], a);
+      Lanes::gatherTransposed(base, &samples.rotationTo[i], b);
+
+      // glm stores quaternions as w, x, y, z, which the interpolation does not depend on
+      nlerpQuaternions(a, b, factor, rotation);
+      rotation[0].store(&pose.rotationW[i]);
+      rotation[1].store(&pose.rotationX[i]);
+      rotation[2].store(&pose.rotationY[i]);
+      rotation[3].store(&pose.rotationZ[i]);
+    }
+
+    // Scale
+    {
+      const Lanes factor = Lanes::load(&samples.scaleFactor[i]);
+      const float* base = &clip.scaleKeyframes[0].x;
+      const int32_t* from = &samples.scaleFrom[i];
+      const int32_t* to = &samples.scaleTo[i];
+      for (int component = 0; component < 3; ++component)
+      {
+        const Lanes a = Lanes::gather(base + component, from), b = Lanes::gather(base + component, to);
+        (a + (b - a) * factor).store(&pose.scale(component)[i]);
+      }
+    }
+  }
+}
+
+// Composes translation * rotation * scale of each bone in the local pose into its posed transform in bone space
+template<typename Lanes>
+void composeTransforms(const LocalPose& pose, std::vector<AffineTransform>& transforms)
+{
+  const Lanes one = Lanes::broadcast(1.0f), two = Lanes::broadcast(2.0f);
+  for (size_t i = 0u; i < transforms.size(); i += Lanes::width)
+  {
+    const Lanes x = Lanes::load(&pose.rotationX[i]), y = Lanes::load(&pose.rotationY[i]),
+                z = Lanes::load(&pose.rotationZ[i]), w = Lanes::load(&pose.rotationW[i]);
+    const Lanes scaleX = Lanes::load(&pose.scaleX[i]), scaleY = Lanes::load(&pose.scaleY[i]),
+                scaleZ = Lanes::load(&pose.scaleZ[i]);
+
+    const Lanes xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y,
+                wz = w * z;
+
+    // The rows of the transforms
+    const Lanes rows[3][4] = {
+      { (one - two * (yy + zz)) * scaleX, two * (xy - wz) * scaleY, two * (xz + wy) * scaleZ,
+        Lanes::load(&pose.translationX[i]) },
+      { two * (xy + wz) * scaleX, (one - two * (xx + zz)) * scaleY, two * (yz - wx) * scaleZ,
+        Lanes::load(&pose.translationY[i]) },
+      { two * (xz - wy) * scaleX, two * (yz + wx) * scaleY, (one - two * (xx + yy)) * scaleZ,
+        Lanes::load(&pose.translationZ[i]) }
+    };
+
+    // Transpose the lanes into the transforms, skipping the padding after the last bone
+    const size_t laneCount = std::min(Lanes::width, transforms.size() - i);
+    for (int row = 0; row < 3; ++row)
+    {
+      Lanes::storeTransposed(rows[row], &transforms[i].rows[row].x, 12u, laneCount);
+    }
+  }
+}
+
+// Samples the clip at the time in seconds (which wraps around at the end of the clip) into the local pose with the
+// kernels of the given lanes
+template<typename Lanes>
+void sampleClip(const Clip& clip, double time, std::vector<Cursor>& cursors, LocalPose& localPose)
+{
+  static thread_local KeyframeSamples samples;
+
+  const float clipTime = clip.duration > 0.0f ? static_cast<float>(std::fmod(time, clip.duration)) : 0.0f;
+
+  // Find the keyframes to interpolate for each bone, the padding lanes sample the first keyframes
+  const size_t laneCount = localPose.translationX.size();
+  for (std::vector<int32_t>* offsets : { &samples.translationFrom, &samples.translationTo, &samples.rotationFrom,
+                                         &samples.rotationTo, &samples.scaleFrom, &samples.scaleTo })
+  {
+    offsets->assign(laneCount, 0);
+  }
+
+  for (std::vector<float>* factors : { &samples.translationFactor, &samples.rotationFactor, &samples.scaleFactor })
+  {
+    factors->assign(laneCount, 0.0f);
+  }
+
+  for (size_t i = 0u; i < cursors.size(); ++i)
+  {
+    Cursor& cursor = cursors[i];
+    findKeyframes(clip.translationTimes, clip.translationTracks[i], clipTime, 3, cursor.translation,
+                  samples.translationFrom[i], samples.translationTo[i], samples.translationFactor[i]);
+    findKeyframes(clip.rotationTimes, clip.rotationTracks[i], clipTime, 4, cursor.rotation, samples.rotationFrom[i],
+                  samples.rotationTo[i], samples.rotationFactor[i]);
+    findKeyframes(clip.scaleTimes, clip.scaleTracks[i], clipTime, 3, cursor.scale, samples.scaleFrom[i],
+                  samples.scaleTo[i], samples.scaleFactor[i]);
+  }
+
+  interpolateKeyframes<Lanes>(clip, samples, localPose);
+}
+
+// Updates the transforms of the pose from its local pose with the kernels of the given lanes
+template<typename Lanes>
+void updateTransforms(const Skeleton& skeleton, Pose& pose)
+{
+  const std::vector<Bone>& bones = skeleton.bones;
+  composeTransforms<Lanes>(pose.localPose, pose.posedTransforms);
+
+  // Update the posed transform for each bone, the bones are sorted so that the posed transform of the parent has
+  // always been updated already
+  for (size_t i = 0u; i < bones.size(); ++i)
+  {
+    const Bone& bone = bones[i];
+    AffineTransform& posedTransform = pose.posedTransforms[i];
+
+    // Find the posed bone transform in model space by appending the posed bone transform in bone space to the posed
+    // transform of the parent in model space
+    if (bone.parent >= 0)
+    {
+      Lanes::multiply(pose.posedTransforms[bone.parent], posedTransform, posedTransform);
+    }
+
+    // Store the transform from the unposed to the posed bone in model space by transforming from the unposed bone to
+    // the model space origin (through the inverse bind matrix) and then from there to the posed bone in model space
+    Lanes::multiply(posedTransform, bone.inverseBindMatrix, pose.boneTransforms[i]);
+  }
+}
+
+} // namespace
+
+void LocalPose::resize(size_t boneCount)
+{
+  // Pad with identity transforms
+  const size_t laneCount = getPaddedBoneCount(boneCount);
+  for (std::vector<float>* lanes : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ })
+  {
+    lanes->assign(laneCount, 0.0f);
+  }
+
+  for (std::vector<float>* lanes : { &rotationW, &scaleX, &scaleY, &scaleZ })
+  {
+    lanes->assign(laneCount, 1.0f);
+  }
+}
+
+std::vector<float>& LocalPose::translation(int component)
+{
+  return component == 0 ? translationX : (component == 1 ? translationY : translationZ);
+}
+
+std::vector<float>& LocalPose::scale(int component)
+{
+  return component == 0 ? scaleX : (component == 1 ? scaleY : scaleZ);
+}
+
+void Pose::resize(size_t boneCount)
+{
+  cursors.assign(boneCount, Cursor());
+  localPose.resize(boneCount);
+  posedTransforms.resize(boneCount);
+  boneTransforms.resize(boneCount);
+  boneDualQuaternions.resize(boneCount);
+  previousLocalPose.resize(boneCount);
+  previousBoneDualQuaternions.resize(boneCount);
+}
+
+void Pose::keepPreviousBoneTransforms()
+{
+  // The current local pose and transforms are overwritten by the next update, so swapping saves copying them
+  std::swap(localPose, previousLocalPose);
+  boneDualQuaternions.swap(previousBoneDualQuaternions);
+}
+
+size_t getPaddedBoneCount(size_t boneCount)
+{
+  return (boneCount + maxSimdWidth - 1u) / maxSimdWidth * maxSimdWidth;
+}
+
+void sampleClip(const Clip& clip, double time, std::vector<Cursor>& cursors, LocalPose& localPose)
+{
+  sampleClip<SimdLanes>(clip, time, cursors, localPose);
+}
+
+void sampleClip(const Clip& clip, double time, std::vector<Cursor>& cursors, LocalPose& localPose, Kernel kernel)
+{
+  dispatchKernel(kernel, [&](auto lanes) { sampleClip<decltype(lanes)>(clip, time, cursors, localPose); });
+}
+
+void updateTransforms(const Skeleton& skeleton, Pose& pose)
+{
+  updateTransforms<SimdLanes>(skeleton, pose);
+}
+
+void updateTransforms(const Skeleton& skeleton, Pose& pose, Kernel kernel)
+{
+  dispatchKernel(kernel, [&](auto lanes) { updateTransforms<decltype(lanes)>(skeleton, pose); });
+}
+
+void updatePose(const Skeleton& skeleton, const Clip& clip, double time, Pose& pose)
+{
+  sampleClip<SimdLanes>(clip, time, pose.cursors, pose.localPose);
+  updateTransforms<SimdLanes>(skeleton, pose);
+}
+
+void updatePose(const Skeleton& skeleton, const Clip& clip, double time, Pose& pose, Kernel kernel)
+{
+  dispatchKernel(kernel,
+                 [&](auto lanes)
+                 {
+                   sampleClip<decltype(lanes)>(clip, time, pose.cursors, pose.localPose);
+                   updateTransforms<decltype(lanes)>(skeleton, pose);
+                 });
+}
+
+void interpolateBoneTransforms(const Skeleton& skeleton,
+                               const Pose& pose,
+                               float factor,
+                               AffineTransform* boneTransforms)
+{
+  // Pose a scratch pose that only needs resizing for new skeletons
+  static thread_local Pose interpolatedPose;
+  if (interpolatedPose.boneTransforms.size() != skeleton.bones.size())
+  {
+    interpolatedPose.resize(skeleton.bones.size());
+  }
+
+  blendLocalPoses(pose.previousLocalPose, pose.localPose, factor, nullptr, interpolatedPose.localPose);
+  updateTransforms<SimdLanes>(skeleton, interpolatedPose);
+  std::copy(interpolatedPose.boneTransforms.begin(), interpolatedPose.boneTransforms.end(), boneTransforms);
+}
+
+void interpolateBoneTransforms(const Pose& pose, float factor, DualQuaternion* boneDualQuaternions)
+{
+  for (size_t i = 0u; i < pose.boneDualQuaternions.size(); ++i)
+  {
+    const DualQuaternion& from = pose.previousBoneDualQuaternions[i];
+    const DualQuaternion& to = pose.boneDualQuaternions[i];
+    const float toFactor = glm::dot(from.real, to.real) < 0.0f ? -factor : factor;
+    boneDualQuaternions[i] = { from.real * (1.0f - factor) + to.real * toFactor,
+                               from.dual * (1.0f - factor) + to.dual * toFactor };
+  }
+}
+
+} // namespace poser
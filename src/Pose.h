@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Affine.h"
+#include "Clip.h"
+#include "DualQuaternion.h"
+#include "Kernel.h"
+#include "Skeleton.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace poser
+{
+
+// Keyframe cursor definition, remembers the keyframe that each track of a bone was last sampled at (relative to the
+// start of the track) so that sampling at advancing times finds the keyframes in amortised constant time
+struct Cursor
+{
+  uint32_t translation = 0u, rotation = 0u, scale = 0u;
+};
+
+// Local pose definition, the translation, rotation and scale of each bone in bone space in structure of arrays layout
+// so that the pose kernels can process several bones at once, padded to a multiple of the widest SIMD lanes
+struct LocalPose
+{
+  std::vector<float> translationX, translationY, translationZ;
+  std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+  std::vector<float> scaleX, scaleY, scaleZ;
+
+  void resize(size_t boneCount);
+
+  std::vector<float>& translation(int component);
+  std::vector<float>& scale(int component);
+};
+
+// Pose definition, the state of playing back a clip on a skeleton
+struct Pose
+{
+  std::vector<Cursor> cursors;                     // Indexed like the bones
+  LocalPose localPose;
+  std::vector<AffineTransform> posedTransforms;    // Posed bone transforms in model space (transforms from model space
+                                                   // origin to posed bone), indexed like the bones
+  std::vector<AffineTransform> boneTransforms;     // Transforms from unposed to posed bone in model space, indexed like
+                                                   // the bones
+  std::vector<DualQuaternion> boneDualQuaternions; // The bone transforms as dual quaternions, only updated for dual
+                                                   // quaternion skinning
+
+  LocalPose previousLocalPose;                             // The local pose before the last update
+  std::vector<DualQuaternion> previousBoneDualQuaternions; // The bone dual quaternions before the last update
+
+  void resize(size_t boneCount); // Also rewinds the cursors
+
+  // Keeps the current local pose and bone dual quaternions as the previous ones, to be called before updating them,
+  // which must sample the local pose anew
+  void keepPreviousBoneTransforms();
+};
+
+// Returns the number of bones the pose data is padded to for the given number of bones
+size_t getPaddedBoneCount(size_t boneCount);
+
+// Samples the clip at the time in seconds (which wraps around at the end of the clip) into the local pose with the
+// widest kernels available, advancing the cursors (which are indexed like the bones)
+void sampleClip(const Clip& clip, double time, std::vector<Cursor>& cursors, LocalPose& localPose);
+
+// Samples the clip with the given kernels, which must be available in this build
+void sampleClip(const Clip& clip, double time, std::vector<Cursor>& cursors, LocalPose& localPose, Kernel kernel);
+
+// Updates the posed and bone transforms of the pose from its local pose with the widest kernels available
+void updateTransforms(const Skeleton& skeleton, Pose& pose);
+
+// Updates the transforms of the pose with the given kernels, which must be available in this build
+void updateTransforms(const Skeleton& skeleton, Pose& pose, Kernel kernel);
+
+// Poses the skeleton at the time in seconds (which wraps around at the end of the clip) with the widest kernels
+// available, samples the clip and updates the transforms
+void updatePose(const Skeleton& skeleton, const Clip& clip, double time, Pose& pose);
+
+// Poses the skeleton at the time in seconds with the given kernels, which must be available in this build
+void updatePose(const Skeleton& skeleton, const Clip& clip, double time, Pose& pose, Kernel kernel);
+
+// Writes the bone transforms interpolated from the previous to the current ones by the factor (0 is the previous, 1 the
+// current transforms), for rendering between two updates of the pose at a fixed rate, blends the local poses and runs
+// the bone hierarchy on the result with the widest kernels available since blending the affine bone transforms
+// themselves would shear and shrink bones that turn between the updates
+void interpolateBoneTransforms(const Skeleton& skeleton,
+                               const Pose& pose,
+                               float factor,
+                               AffineTransform* boneTransforms);
+
+// Writes the bone dual quaternions interpolated from the previous to the current ones by the factor along the shorter
+// arc, not normalized since skinning normalizes the blended dual quaternions anyway
+void interpolateBoneTransforms(const Pose& pose, float factor, DualQuaternion* boneDualQuaternions);
+
+} // namespace poser
@@ -0,0 +1,261 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace poser
+{
+
+namespace
+{
+
+// Profiler constants
+constexpr size_t ringCapacity = 65536u; // Scopes kept per thread, older ones are overwritten
+
+// Profile event definition, a scope that ended, times in nanoseconds since the program started
+struct ProfileEvent
+{
+  const char* name;
+  int64_t start, end;
+  uint32_t depth;
+};
+
+// Ring buffer definition, written by its thread alone without locks and read once the threads are idle, the write
+// count is published with release semantics after each event so that a reader sees only complete events
+struct RingBuffer
+{
+  std::vector<ProfileEvent> events = std::vector<ProfileEvent>(ringCapacity);
+  std::atomic<uint64_t> writeCount = 0u;
+  uint32_t threadIndex;
+};
+
+// Profiler definition, the ring buffers of all threads that recorded a scope, which outlive their threads so that the
+// scopes of finished threads can still be written out
+struct Profiler
+{
+  std::mutex mutex; // Only taken when a thread records its first scope and when reading
+  std::vector<std::unique_ptr<RingBuffer>> ringBuffers;
+};
+
+// Times are relative to the start of the program so that they fit the trace viewers
+const std::chrono::steady_clock::time_point profilerStart = std::chrono::steady_clock::now();
+
+Profiler& getProfiler()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+// Returns the ring buffer of the calling thread, creating it on first use
+RingBuffer& getRingBuffer()
+{
+  static thread_local RingBuffer* ringBuffer = nullptr;
+  if (!ringBuffer)
+  {
+    Profiler& profiler = getProfiler();
+    const std::lock_guard<std::mutex> lock(profiler.mutex);
+    ringBuffer = profiler.ringBuffers.emplace_back(std::make_unique<RingBuffer>()).get();
+    ringBuffer->threadIndex = static_cast<uint32_t>(profiler.ringBuffers.size() - 1u);
+  }
+  return *ringBuffer;
+}
+
+thread_local uint32_t scopeDepth = 0u; // Of the innermost open scope of the calling thread
+
+int64_t getProfileTime(std::chrono::steady_clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time - profilerStart).count();
+}
+
+// Thread events definition, the recorded events of a thread that are still in its ring buffer
+struct ThreadEvents
+{
+  uint32_t threadIndex;
+  std::vector<ProfileEvent> events; // Sorted by start time, outer scopes before the inner scopes starting with them
+};
+
+// Copies the recorded events of all threads
+std::vector<ThreadEvents> readEvents()
+{
+  Profiler& profiler = getProfiler();
+  const std::lock_guard<std::mutex> lock(profiler.mutex);
+
+  std::vector<ThreadEvents> threadEvents;
+  for (const std::unique_ptr<RingBuffer>& ringBuffer : profiler.ringBuffers)
+  {
+    ThreadEvents& thread = threadEvents.emplace_back();
+    thread.threadIndex = ringBuffer->threadIndex;
+
+    const uint64_t writeCount = ringBuffer->writeCount.load(std::memory_order_acquire);
+    for (uint64_t i = writeCount > ringCapacity ? writeCount - ringCapacity : 0u; i < writeCount; ++i)
+    {
+      thread.events.push_back(ringBuffer->events[i % ringCapacity]);
+    }
+
+    // Scopes are recorded when they end, so inner scopes come before the outer ones
+    std::sort(thread.events.begin(), thread.events.end(),
+              [](const ProfileEvent& a, const ProfileEvent& b)
+              { return a.start != b.start ? a.start < b.start : a.depth < b.depth; });
+  }
+  return threadEvents;
+}
+
+// Scope node definition, the durations of a scope name called from the same chain of enclosing scopes across threads
+struct ScopeNode
+{
+  std::vector<double> durations; // In milliseconds
+  int64_t total = 0;
+  std::map<std::string, ScopeNode> children;
+};
+
+// Prints the stats of the children of the node, the most expensive first, indented by their depth
+void printScopeNodes(std::ostream& stream, ScopeNode& node, size_t depth)
+{
+  std::vector<std::pair<const std::string*, ScopeNode*>> children;
+  for (auto& [name, child] : node.children)
+  {
+    children.emplace_back(&name, &child);
+  }
+  std::sort(children.begin(), children.end(),
+            [](const auto& a, const auto& b) { return a.second->total > b.second->total; });
+
+  for (const auto& [name, child] : children)
+  {
+    std::sort(child->durations.begin(), child->durations.end());
+    const size_t count = child->durations.size();
+    stream << std::left << std::setw(40) << std::string(2u * depth, ' ') + *name << std::right << std::setw(8) << count
+           << std::setw(11) << static_cast<double>(child->total) * 1.0e-6 / static_cast<double>(count)
+           << std::setw(11) << getPercentile(child->durations, 99.0) << std::setw(11)
+           << static_cast<double>(child->total) * 1.0e-6 << "\n";
+    printScopeNodes(stream, *child, depth + 1u);
+  }
+}
+
+} // namespace
+
+ProfileScope::ProfileScope(const char* name) : name(name), start(std::chrono::steady_clock::now())
+{
+  ++scopeDepth;
+}
+
+ProfileScope::~ProfileScope()
+{
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  --scopeDepth;
+
+  RingBuffer& ringBuffer = getRingBuffer();
+  const uint64_t writeCount = ringBuffer.writeCount.load(std::memory_order_relaxed);
+  ringBuffer.events[writeCount % ringCapacity] = { name, getProfileTime(start), getProfileTime(end), scopeDepth };
+  ringBuffer.writeCount.store(writeCount + 1u, std::memory_order_release);
+}
+
+bool isProfilerEnabled()
+{
+#if defined(POSER_PROFILER)
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool writeChromeTrace(const char* fileName)
+{
+  std::ofstream file(fileName);
+  if (!file)
+  {
+    std::cerr << "Failed to open trace file " << fileName << " for writing\n";
+    return false;
+  }
+
+  // Complete events with times in microseconds, one track per thread
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  file << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (const ThreadEvents& thread : readEvents())
+  {
+    for (const ProfileEvent& event : thread.events)
+    {
+      file << (first ? "\n" : ",\n") << "{\"name\":";
+      writeJsonString(file, event.name);
+      file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread.threadIndex << ",\"ts\":" << event.start * 1.0e-3
+           << ",\"dur\":" << (event.end - event.start) * 1.0e-3 << "}";
+      first = false;
+    }
+  }
+  file << "\n]}\n";
+
+  if (!file)
+  {
+    std::cerr << "Failed to write trace file " << fileName << "\n";
+    return false;
+  }
+  return true;
+}
+
+void printProfileStats(std::ostream& stream)
+{
+  // Rebuild the hierarchy of each thread from the depths of its scopes, scopes whose enclosing scopes were already
+  // overwritten in the ring buffer end up higher up
+  ScopeNode root;
+  for (const ThreadEvents& thread : readEvents())
+  {
+    std::vector<ScopeNode*> enclosingNodes;
+    for (const ProfileEvent& event : thread.events)
+    {
+      enclosingNodes.resize(std::min(enclosingNodes.size(), static_cast<size_t>(event.depth)));
+      ScopeNode& parent = enclosingNodes.empty() ? root : *enclosingNodes.back();
+      ScopeNode& node = parent.children[event.name];
+      node.durations.push_back(static_cast<double>(event.end - event.start) * 1.0e-6);
+      node.total += event.end - event.start;
+      enclosingNodes.push_back(&node);
+    }
+  }
+
+  stream << std::left << std::setw(40) << "Scope" << std::right << std::setw(8) << "Calls" << std::setw(11)
+         << "Mean ms" << std::setw(11) << "p99 ms" << std::setw(11) << "Total ms" << "\n";
+  stream << std::fixed << std::setprecision(3);
+  printScopeNodes(stream, root, 0u);
+  stream << std::defaultfloat;
+}
+
+void resetProfiler()
+{
+  Profiler& profiler = getProfiler();
+  const std::lock_guard<std::mutex> lock(profiler.mutex);
+  for (const std::unique_ptr<RingBuffer>& ringBuffer : profiler.ringBuffers)
+  {
+    ringBuffer->writeCount.store(0u, std::memory_order_relaxed);
+  }
+}
+
+double getPercentile(const std::vector<double>& sortedValues, double percentile)
+{
+  const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(sortedValues.size())));
+  return sortedValues.at(std::clamp(rank, size_t(1u), sortedValues.size()) - 1u);
+}
+
+void writeJsonString(std::ostream& stream, std::string_view string)
+{
+  stream << '"';
+  for (const char character : string)
+  {
+    if (character == '"' || character == '\\')
+    {
+      stream << '\\';
+    }
+    stream << character;
+  }
+  stream << '"';
+}
+
+} // namespace poser
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Scoped timer macros, record the time from the macro to the end of the enclosing scope under the name (which must be
+// a string literal or otherwise outlive the profiler), compiled out unless the build enables the profiler
+#if defined(POSER_PROFILER)
+  #define POSER_PROFILE_CONCATENATE_INNER(a, b) a##b
+  #define POSER_PROFILE_CONCATENATE(a, b) POSER_PROFILE_CONCATENATE_INNER(a, b)
+  #define POSER_PROFILE_SCOPE(name) const ::poser::ProfileScope POSER_PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#else
+  #define POSER_PROFILE_SCOPE(name)
+#endif
+
+namespace poser
+{
+
+// Profile scope definition, records the time between its construction and destruction into the ring buffer of the
+// calling thread, nested scopes record their depth so that the trace shows the hierarchy
+class ProfileScope
+{
+public:
+  explicit ProfileScope(const char* name);
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  const char* name;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Returns true if the profiler was compiled in, otherwise the scopes record nothing
+bool isProfilerEnabled();
+
+// Writes the recorded scopes of all threads as a Chrome trace (which Perfetto opens as well), returns false on failure,
+// the threads must not record scopes meanwhile
+bool writeChromeTrace(const char* fileName);
+
+// Prints the call count, mean and 99th percentile duration and total time of each scope name across all threads,
+// widest scopes first and indented by nesting depth, the threads must not record scopes meanwhile
+void printProfileStats(std::ostream& stream);
+
+// Discards all recorded scopes, the threads must not record scopes meanwhile
+void resetProfiler();
+
+// Returns the value at the percentile (between 0 and 100) of the sorted values using the nearest rank, for the timing
+// statistics of the benchmarks
+double getPercentile(const std::vector<double>& sortedValues, double percentile);
+
+// Writes the string as a JSON string literal, for the trace and the benchmark results
+void writeJsonString(std::ostream& stream, std::string_view string);
+
+} // namespace poser
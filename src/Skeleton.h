@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Affine.h"
+
+#include <vector>
+
+namespace poser
+{
+
+// Bone definition
+struct Bone
+{
+  // Inverse bind pose bone transform (transforms from unposed bone to model space origin), the identity for bones that
+  // no mesh skins
+  AffineTransform inverseBindMatrix = toAffineTransform(glm::mat4(1.0f));
+  int parent = -1; // Index of the parent bone, always lower than the index of this bone, -1 for root bones
+};
+
+// Skeleton definition, the bones are sorted so that each parent comes before its children
+struct Skeleton
+{
+  std::vector<Bone> bones;
+};
+
+} // namespace poser
@@ -0,0 +1,493 @@
+#include "Skinning.h"
+
+#include "Lanes.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace poser
+{
+
+namespace
+{
+
+// Skinning constants
+constexpr size_t skinningChunkSize = 1024u; // Vertices per task, about 80 KiB of vertices and skinned vertices so that
+                                            // a task stays in the L2 cache, a multiple of the widest lanes
+
+// Vertex and bone transform layouts in floats
+static_assert(sizeof(Vertex) % sizeof(float) == 0u && sizeof(PackedVertex8) % sizeof(float) == 0u &&
+              sizeof(PackedVertex16) % sizeof(float) == 0u && sizeof(AffineTransform) == 12u * sizeof(float) &&
+              sizeof(DualQuaternion) == 8u * sizeof(float));
+template<typename VertexType>
+constexpr int32_t vertexStride = sizeof(VertexType) / sizeof(float);
+template<typename VertexType>
+constexpr size_t positionOffset = offsetof(VertexType, position) / sizeof(float);
+
+// Calls the function with the influence count as an std::integral_constant, so that it is specialized for the count
+template<typename Function>
+void dispatchInfluenceCount(int influenceCount, Function&& function)
+{
+  assert(influenceCount >= 1 && influenceCount <= maxInfluenceCount);
+  [&]<int... counts>(std::integer_sequence<int, counts...>)
+  {
+    ((influenceCount == counts + 1 ? function(std::integral_constant<int, counts + 1>()) : void()), ...);
+  }(std::make_integer_sequence<int, maxInfluenceCount>());
+}
+
+// Vertex accessors for the kernels, missing bones read as the first bone with a weight of zero
+int getBoneId(const Vertex& vertex, int influence)
+{
+  return std::max(vertex.boneIds[influence], 0);
+}
+
+float getBoneWeight(const Vertex& vertex, int influence)
+{
+  return vertex.boneIds[influence] >= 0 ? vertex.boneWeights[influence] : 0.0f;
+}
+
+template<typename Component>
+int getBoneId(const PackedVertex<Component>& vertex, int influence)
+{
+  return vertex.boneIds[influence];
+}
+
+template<typename Component>
+float getBoneWeight(const PackedVertex<Component>& vertex, int influence)
+{
+  return static_cast<float>(vertex.boneWeights[influence]) * (1.0f / std::numeric_limits<Component>::max());
+}
+
+// Returns true if the bone transforms cover the bones of the influences of the vertices in [begin, end)
+template<typename VertexType>
+bool coversBoneIds(const std::vector<VertexType>& vertices, size_t begin, size_t end, size_t boneTransformCount)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    for (int influence = 0; influence < maxInfluenceCount; ++influence)
+    {
+      if (static_cast<size_t>(getBoneId(vertices[i], influence)) >= boneTransformCount)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Loads the normals of the vertices at the offsets (in floats) into the lanes, the fourth lane holds the next float of
+// the vertex and is ignored
+template<typename Lanes>
+void loadNormals(const Vertex* vertices, const int32_t* vertexOffsets, Lanes (&normal)[4])
+{
+  constexpr size_t normalOffset = offsetof(Vertex, normal) / sizeof(float);
+  Lanes::gatherTransposed(reinterpret_cast<const float*>(vertices) + normalOffset, vertexOffsets, normal);
+}
+
+// Decodes the octahedral normals of the packed vertices at the offsets (in floats) into the lanes, the decoded normals
+// are not normalized as the skinned normals are normalized anyway
+template<typename Lanes, typename Component>
+void loadNormals(const PackedVertex<Component>* vertices, const int32_t* vertexOffsets, Lanes (&normal)[4])
+{
+  constexpr float normalScale = 1.0f / 32767.0f;
+  float encoded[2][Lanes::width];
+  for (size_t lane = 0u; lane < Lanes::width; ++lane)
+  {
+    const PackedVertex<Component>& vertex = vertices[vertexOffsets[lane] / vertexStride<PackedVertex<Component>>];
+    encoded[0][lane] = static_cast<float>(vertex.normal[0]) * normalScale;
+    encoded[1][lane] = static_cast<float>(vertex.normal[1]) * normalScale;
+  }
+
+  // Unfold the lower half of the octahedron, flipSign(value, value) is the absolute value
+  const Lanes one = Lanes::broadcast(1.0f), half = Lanes::broadcast(0.5f);
+  const Lanes x = Lanes::load(encoded[0]), y = Lanes::load(encoded[1]);
+  const Lanes z = one - Lanes::flipSign(x, x) - Lanes::flipSign(y, y);
+  const Lanes fold = (Lanes::flipSign(z, z) - z) * half; // max(-z, 0)
+  normal[0] = x - Lanes::flipSign(fold, x);
+  normal[1] = y - Lanes::flipSign(fold, y);
+  normal[2] = z;
+}
+
+// Blends the affine bone transforms of the influences linearly and applies them to the position and the normal
+template<typename Lanes, int InfluenceCount>
+void blendAndTransform(const AffineTransform* boneTransforms,
+                       const int32_t (&boneIds)[InfluenceCount][Lanes::width],
+                       const Lanes (&weights)[InfluenceCount],
+                       const Lanes (&position)[4],
+                       const Lanes (&normal)[4],
+                       Lanes (&skinnedPosition)[3],
+                       Lanes (&skinnedNormal)[3])
+{
+  const float* base = reinterpret_cast<const float*>(boneTransforms);
+  const Lanes zero = Lanes::broadcast(0.0f);
+
+  Lanes blended[3][4]; // Indexed by row and column
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      blended[row][column] = zero;
+    }
+  }
+
+  for (int influence = 0; influence < InfluenceCount; ++influence)
+  {
+    int32_t offsets[Lanes::width];
+    for (size_t lane = 0u; lane < Lanes::width; ++lane)
+    {
+      offsets[lane] = boneIds[influence][lane] * 12;
+    }
+
+    for (int row = 0; row < 3; ++row)
+    {
+      Lanes columns[4];
+      Lanes::gatherTransposed(base + row * 4, offsets, columns);
+      for (int column = 0; column < 4; ++column)
+      {
+        blended[row][column] = blended[row][column] + columns[column] * weights[influence];
+      }
+    }
+  }
+
+  for (int row = 0; row < 3; ++row)
+  {
+    skinnedPosition[row] = blended[row][0] * position[0] + blended[row][1] * position[1] +
+                           blended[row][2] * position[2] + blended[row][3];
+    skinnedNormal[row] = blended[row][0] * normal[0] + blended[row][1] * normal[1] + blended[row][2] * normal[2];
+  }
+}
+
+// Blends the dual quaternions of the influences, flipped into the same hemisphere as the first influence, normalizes
+// the blend and applies it to the position and the normal
+template<typename Lanes, int InfluenceCount>
+void blendAndTransform(const DualQuaternion* boneTransforms,
+                       const int32_t (&boneIds)[InfluenceCount][Lanes::width],
+                       const Lanes (&weights)[InfluenceCount],
+                       const Lanes (&position)[4],
+                       const Lanes (&normal)[4],
+                       Lanes (&skinnedPosition)[3],
+                       Lanes (&skinnedNormal)[3])
+{
+  const float* base = reinterpret_cast<const float*>(boneTransforms);
+  const Lanes one = Lanes::broadcast(1.0f), two = Lanes::broadcast(2.0f);
+
+  int32_t offsets[InfluenceCount][Lanes::width];
+  for (int influence = 0; influence < InfluenceCount; ++influence)
+  {
+    for (size_t lane = 0u; lane < Lanes::width; ++lane)
+    {
+      offsets[influence][lane] = boneIds[influence][lane] * 8;
+    }
+  }
+
+  // The first influence is the pivot that the others are flipped towards
+  Lanes real[4], dual[4], pivot[4];
+  Lanes::gatherTransposed(base, offsets[0], pivot);
+  Lanes::gatherTransposed(base + 4, offsets[0], dual);
+  for (int component = 0; component < 4; ++component)
+  {
+    real[component] = pivot[component] * weights[0];
+    dual[component] = dual[component] * weights[0];
+  }
+
+  for (int influence = 1; influence < InfluenceCount; ++influence)
+  {
+    Lanes influenceReal[4], influenceDual[4];
+    Lanes::gatherTransposed(base, offsets[influence], influenceReal);
+    Lanes::gatherTransposed(base + 4, offsets[influence], influenceDual);
+
+    const Lanes alignment = influenceReal[0] * pivot[0] + influenceReal[1] * pivot[1] +
+                            influenceReal[2] * pivot[2] + influenceReal[3] * pivot[3];
+    const Lanes weight = Lanes::flipSign(weights[influence], alignment);
+    for (int component = 0; component < 4; ++component)
+    {
+      real[component] = real[component] + influenceReal[component] * weight;
+      dual[component] = dual[component] + influenceDual[component] * weight;
+    }
+  }
+
+  const Lanes inverseLength =
+    one / Lanes::sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+  for (int component = 0; component < 4; ++component)
+  {
+    real[component] = real[component] * inverseLength;
+    dual[component] = dual[component] * inverseLength;
+  }
+
+  // Rotates the vector by the real part, v + 2 * cross(r.xyz, cross(r.xyz, v) + r.w * v)
+  const auto rotate = [&real, two](const Lanes (&vector)[4], Lanes (&result)[3])
+  {
+    const Lanes inner[3] = { real[1] * vector[2] - real[2] * vector[1] + real[3] * vector[0],
+                             real[2] * vector[0] - real[0] * vector[2] + real[3] * vector[1],
+                             real[0] * vector[1] - real[1] * vector[0] + real[3] * vector[2] };
+    result[0] = vector[0] + two * (real[1] * inner[2] - real[2] * inner[1]);
+    result[1] = vector[1] + two * (real[2] * inner[0] - real[0] * inner[2]);
+    result[2] = vector[2] + two * (real[0] * inner[1] - real[1] * inner[0]);
+  };
+
+  rotate(position, skinnedPosition);
+  rotate(normal, skinnedNormal);
+
+  // Translate by 2 * (r.w * d.xyz - d.w * r.xyz + cross(r.xyz, d.xyz))
+  const Lanes translation[3] = { real[3] * dual[0] - dual[3] * real[0] + real[1] * dual[2] - real[2] * dual[1],
+                                 real[3] * dual[1] - dual[3] * real[1] + real[2] * dual[0] - real[0] * dual[2],
+                                 real[3] * dual[2] - dual[3] * real[2] + real[0] * dual[1] - real[1] * dual[0] };
+  for (int component = 0; component < 3; ++component)
+  {
+    skinnedPosition[component] = skinnedPosition[component] + two * translation[component];
+  }
+}
+
+// Skins the vertices with the kernels of the given lanes, each lane processes one vertex, reading only the given number
+// of influences of each vertex
+template<typename Lanes, int InfluenceCount, typename VertexType, typename BoneTransform>
+void skinVertexLanes(const VertexType* vertices,
+                     const BoneTransform* boneTransforms,
+                     size_t count,
+                     SkinnedVertex* skinnedVertices)
+{
+  const Lanes one = Lanes::broadcast(1.0f);
+
+  for (size_t i = 0u; i < count; i += Lanes::width)
+  {
+    const size_t laneCount = std::min(Lanes::width, count - i);
+
+    // Find the offsets of the vertices and the bones affecting them, missing bones are replaced by the first bone with
+    // a weight of zero and the lanes past the last vertex repeat it
+    int32_t vertexOffsets[Lanes::width];
+    int32_t boneIds[InfluenceCount][Lanes::width];
+    float influenceWeights[InfluenceCount][Lanes::width];
+    for (size_t lane = 0u; lane < Lanes::width; ++lane)
+    {
+      const size_t index = std::min(lane, laneCount - 1u);
+      const VertexType& vertex = vertices[i + index];
+      vertexOffsets[lane] = static_cast<int32_t>(index) * vertexStride<VertexType>;
+      for (int influence = 0; influence < InfluenceCount; ++influence)
+      {
+        boneIds[influence][lane] = getBoneId(vertex, influence);
+        influenceWeights[influence][lane] = getBoneWeight(vertex, influence);
+      }
+    }
+
+    Lanes weights[InfluenceCount];
+    for (int influence = 0; influence < InfluenceCount; ++influence)
+    {
+      weights[influence] = Lanes::load(influenceWeights[influence]);
+    }
+
+    // Transform the position and the normal, the fourth lane of the position holds the next float of the vertex and is
+    // ignored
+    const float* vertexBase = reinterpret_cast<const float*>(vertices + i);
+    Lanes position[4], normal[4];
+    Lanes::gatherTransposed(vertexBase + positionOffset<VertexType>, vertexOffsets, position);
+    loadNormals<Lanes>(vertices + i, vertexOffsets, normal);
+
+    Lanes skinnedPosition[3], skinnedNormal[3];
+    blendAndTransform<Lanes, InfluenceCount>(boneTransforms, boneIds, weights, position, normal, skinnedPosition,
+                                             skinnedNormal);
+
+    const Lanes inverseLength = one / Lanes::sqrt(skinnedNormal[0] * skinnedNormal[0] +
+                                                  skinnedNormal[1] * skinnedNormal[1] +
+                                                  skinnedNormal[2] * skinnedNormal[2]);
+
+    // Write the skinned vertices, skipping the lanes past the last vertex
+    float components[6][Lanes::width];
+    for (int row = 0; row < 3; ++row)
+    {
+      skinnedPosition[row].store(components[row]);
+      (skinnedNormal[row] * inverseLength).store(components[3 + row]);
+    }
+
+    for (size_t lane = 0u; lane < laneCount; ++lane)
+    {
+      SkinnedVertex& skinnedVertex = skinnedVertices[i + lane];
+      skinnedVertex.position = glm::vec3(components[0][lane], components[1][lane], components[2][lane]);
+      skinnedVertex.normal = glm::vec3(components[3][lane], components[4][lane], components[5][lane]);
+    }
+  }
+}
+
+} // namespace
+
+template<typename VertexType, typename BoneTransform>
+void skinVertices(const std::vector<VertexType>& vertices,
+                  const std::vector<BoneTransform>& boneTransforms,
+                  size_t begin,
+                  size_t end,
+                  int influenceCount,
+                  std::vector<SkinnedVertex>& skinnedVertices,
+                  Kernel kernel)
+{
+  assert(begin <= end && end <= vertices.size() && end <= skinnedVertices.size());
+  if (boneTransforms.empty())
+  {
+    return;
+  }
+  assert(coversBoneIds(vertices, begin, end, boneTransforms.size()));
+  dispatchKernel(kernel,
+                 [&](auto lanes)
+                 {
+                   dispatchInfluenceCount(influenceCount,
+                                          [&](auto influences)
+                                          {
+                                            skinVertexLanes<decltype(lanes), influences()>(
+                                              vertices.data() + begin, boneTransforms.data(), end - begin,
+                                              skinnedVertices.data() + begin);
+                                          });
+                 });
+}
+
+template<typename VertexType, typename BoneTransform>
+void skinVertices(ThreadPool& threadPool,
+                  const std::vector<VertexType>& vertices,
+                  const std::vector<BoneTransform>& boneTransforms,
+                  const std::vector<InfluenceRange>& influenceRanges,
+                  std::vector<SkinnedVertex>& skinnedVertices)
+{
+  assert(influenceRanges.empty() ? vertices.empty()
+                                 : influenceRanges.front().firstVertex == 0u &&
+                                     influenceRanges.back().firstVertex + influenceRanges.back().vertexCount ==
+                                       vertices.size());
+  skinnedVertices.resize(vertices.size());
+  if (boneTransforms.empty())
+  {
+    return;
+  }
+  assert(coversBoneIds(vertices, 0u, vertices.size(), boneTransforms.size()));
+  threadPool.parallelFor(
+    vertices.size(), skinningChunkSize,
+    [&](size_t begin, size_t end)
+    {
+      // Skin the part of each influence range within the chunk with the kernels specialized for it
+      auto influenceRange =
+        std::upper_bound(influenceRanges.begin(), influenceRanges.end(), begin,
+                         [](size_t vertex, const InfluenceRange& range) { return vertex < range.firstVertex; }) -
+        1;
+      for (; begin < end; ++influenceRange)
+      {
+        const size_t rangeEnd = std::min(end, size_t(influenceRange->firstVertex + influenceRange->vertexCount));
+        dispatchInfluenceCount(influenceRange->influenceCount,
+                               [&](auto influences)
+                               {
+                                 skinVertexLanes<SimdLanes, influences()>(vertices.data() + begin,
+                                                                          boneTransforms.data(), rangeEnd - begin,
+                                                                          skinnedVertices.data() + begin);
+                               });
+        begin = rangeEnd;
+      }
+    });
+}
+
+const char* getSkinningModeName(SkinningMode skinningMode)
+{
+  switch (skinningMode)
+  {
+  case SkinningMode::LinearBlend:
+    return "Linear blend";
+  case SkinningMode::DualQuaternion:
+    return "Dual quaternion";
+  }
+  return "Unknown";
+}
+
+bool isPaletteComplete(size_t boneTransformCount, size_t boneCount)
+{
+  return boneCount > 0u && boneTransformCount >= boneCount;
+}
+
+void skinVerticesReference(const std::vector<Vertex>& vertices,
+                           const std::vector<AffineTransform>& boneTransforms,
+                           size_t begin,
+                           size_t end,
+                           std::vector<SkinnedVertex>& skinnedVertices)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    const Vertex& vertex = vertices.at(i);
+
+    AffineTransform boneTransform = { { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) } };
+    for (int influence = 0; influence < maxInfluenceCount; ++influence)
+    {
+      if (vertex.boneIds[influence] >= 0)
+      {
+        const AffineTransform& influenceTransform = boneTransforms.at(vertex.boneIds[influence]);
+        for (int row = 0; row < 3; ++row)
+        {
+          boneTransform.rows[row] += influenceTransform.rows[row] * vertex.boneWeights[influence];
+        }
+      }
+    }
+
+    SkinnedVertex& skinnedVertex = skinnedVertices.at(i);
+    skinnedVertex.position = transformPoint(boneTransform, vertex.position);
+    skinnedVertex.normal = glm::normalize(transformVector(boneTransform, vertex.normal));
+  }
+}
+
+void skinVerticesReference(const std::vector<Vertex>& vertices,
+                           const std::vector<DualQuaternion>& boneTransforms,
+                           size_t begin,
+                           size_t end,
+                           std::vector<SkinnedVertex>& skinnedVertices)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    const Vertex& vertex = vertices.at(i);
+
+    // Blend in the hemisphere of the first influence so that the blend takes the shortest path
+    DualQuaternion boneTransform = { glm::vec4(0.0f), glm::vec4(0.0f) };
+    const glm::vec4& pivot = boneTransforms.at(std::max(vertex.boneIds[0], 0)).real;
+    for (int influence = 0; influence < maxInfluenceCount; ++influence)
+    {
+      if (vertex.boneIds[influence] >= 0)
+      {
+        const DualQuaternion& influenceTransform = boneTransforms.at(vertex.boneIds[influence]);
+        const float weight = glm::dot(influenceTransform.real, pivot) < 0.0f ? -vertex.boneWeights[influence]
+                                                                              : vertex.boneWeights[influence];
+        boneTransform.real += influenceTransform.real * weight;
+        boneTransform.dual += influenceTransform.dual * weight;
+      }
+    }
+
+    const float inverseLength = 1.0f / glm::length(boneTransform.real);
+    boneTransform.real *= inverseLength;
+    boneTransform.dual *= inverseLength;
+
+    SkinnedVertex& skinnedVertex = skinnedVertices.at(i);
+    skinnedVertex.position = transformPoint(boneTransform, vertex.position);
+    skinnedVertex.normal = glm::normalize(transformVector(boneTransform, vertex.normal));
+  }
+}
+
+// Instantiate the kernels for every vertex type and kind of bone transform
+template void skinVertices(const std::vector<Vertex>&, const std::vector<AffineTransform>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(const std::vector<Vertex>&, const std::vector<DualQuaternion>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(const std::vector<PackedVertex8>&, const std::vector<AffineTransform>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(const std::vector<PackedVertex8>&, const std::vector<DualQuaternion>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(const std::vector<PackedVertex16>&, const std::vector<AffineTransform>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(const std::vector<PackedVertex16>&, const std::vector<DualQuaternion>&, size_t, size_t,
+                           int, std::vector<SkinnedVertex>&, Kernel);
+template void skinVertices(ThreadPool&, const std::vector<Vertex>&, const std::vector<AffineTransform>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+template void skinVertices(ThreadPool&, const std::vector<Vertex>&, const std::vector<DualQuaternion>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+template void skinVertices(ThreadPool&, const std::vector<PackedVertex8>&, const std::vector<AffineTransform>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+template void skinVertices(ThreadPool&, const std::vector<PackedVertex8>&, const std::vector<DualQuaternion>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+template void skinVertices(ThreadPool&, const std::vector<PackedVertex16>&, const std::vector<AffineTransform>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+template void skinVertices(ThreadPool&, const std::vector<PackedVertex16>&, const std::vector<DualQuaternion>&,
+                           const std::vector<InfluenceRange>&, std::vector<SkinnedVertex>&);
+
+} // namespace poser
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Affine.h"
+#include "DualQuaternion.h"
+#include "Kernel.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace poser
+{
+
+// Skinned vertex definition, the vertex transformed by the weighted bone transforms in model space
+struct SkinnedVertex
+{
+  glm::vec3 position, normal;
+};
+
+// How the bone transforms affecting a vertex are blended, linear blending of affine transforms is cheaper while
+// blending dual quaternions preserves the volume around twisting joints but ignores scale
+enum class SkinningMode
+{
+  LinearBlend,
+  DualQuaternion
+};
+
+const char* getSkinningModeName(SkinningMode skinningMode);
+
+// Returns true if a palette of that many bone transforms can skin vertices imported against the bone count, the
+// kernels read a bone for every influence, the first one for missing influences, so the skeleton must have bones and
+// the palette must hold a transform for each of them
+bool isPaletteComplete(size_t boneTransformCount, size_t boneCount);
+
+// Skins the vertices in [begin, end) one at a time with glm like the vertex shader does, to verify the kernels against
+void skinVerticesReference(const std::vector<Vertex>& vertices,
+                           const std::vector<AffineTransform>& boneTransforms,
+                           size_t begin,
+                           size_t end,
+                           std::vector<SkinnedVertex>& skinnedVertices);
+void skinVerticesReference(const std::vector<Vertex>& vertices,
+                           const std::vector<DualQuaternion>& boneTransforms,
+                           size_t begin,
+                           size_t end,
+                           std::vector<SkinnedVertex>& skinnedVertices);
+
+// Skins the vertices in [begin, end) with the given kernels, which must be available in this build, the skinned
+// vertices must already be sized like the vertices, the vertices are either unpacked or packed and the bone transforms
+// either affine transforms or dual quaternions, the kernels are specialized for the influence count (see
+// Mesh::influenceCount) and ignore the influences of a vertex past it, an empty palette (of a model without bones)
+// skips the skinning, otherwise the bone transforms must cover the bone ids of the vertices (see isPaletteComplete)
+template<typename VertexType, typename BoneTransform>
+void skinVertices(const std::vector<VertexType>& vertices,
+                  const std::vector<BoneTransform>& boneTransforms,
+                  size_t begin,
+                  size_t end,
+                  int influenceCount,
+                  std::vector<SkinnedVertex>& skinnedVertices,
+                  Kernel kernel);
+
+// Skins all vertices with the widest kernels available specialized for the influence count of each influence range
+// (see getInfluenceRanges), which must cover the vertices in order, spread across the threads of the thread pool in
+// chunks that fit into the cache, an empty palette skips the skinning like above
+template<typename VertexType, typename BoneTransform>
+void skinVertices(ThreadPool& threadPool,
+                  const std::vector<VertexType>& vertices,
+                  const std::vector<BoneTransform>& boneTransforms,
+                  const std::vector<InfluenceRange>& influenceRanges,
+                  std::vector<SkinnedVertex>& skinnedVertices);
+
+} // namespace poser
@@ -0,0 +1,302 @@
+#include "Synthetic.h"
+
+#include <assimp/scene.h>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace poser
+{
+
+namespace
+{
+
+// Animation constants
+constexpr double syntheticTicksPerSecond = 30.0;
+
+// Mesh constants
+constexpr float minSyntheticWeight = 0.05f; // Before normalization, so that no influence vanishes
+
+// Builds the bone nodes under the root node following the parents, with the helper nodes spread over the bones
+void makeNodes(const std::vector<int>& parents, int helperCount, aiScene& scene)
+{
+  scene.mRootNode = new aiNode("Root");
+  std::vector<aiNode*> boneNodes(parents.size());
+  std::vector<std::vector<aiNode*>> children(parents.size()), rootChildren(1u);
+  for (size_t i = 0u; i < parents.size(); ++i)
+  {
+    boneNodes.at(i) = new aiNode("Bone" + std::to_string(i));
+    (parents.at(i) >= 0 ? children.at(parents.at(i)) : rootChildren.at(0u)).push_back(boneNodes.at(i));
+  }
+
+  for (int i = 0; i < helperCount; ++i)
+  {
+    children.at(static_cast<size_t>(i) % children.size()).push_back(new aiNode("Helper" + std::to_string(i)));
+  }
+
+  scene.mRootNode->addChildren(static_cast<unsigned int>(rootChildren.at(0u).size()), rootChildren.at(0u).data());
+  for (size_t i = 0u; i < boneNodes.size(); ++i)
+  {
+    if (!children.at(i).empty())
+    {
+      boneNodes.at(i)->addChildren(static_cast<unsigned int>(children.at(i).size()), children.at(i).data());
+    }
+  }
+}
+
+// Builds the mesh of the rig as a triangle strip through its vertices, with random positions, normals and weights drawn
+// from its seed
+aiMesh* makeMesh(const SyntheticRig& rig, const std::vector<int>& parents)
+{
+  const unsigned int boneCount = static_cast<unsigned int>(parents.size());
+  const unsigned int vertexCount = static_cast<unsigned int>(std::max(rig.vertexCount, 3));
+  const size_t influenceCount = static_cast<size_t>(std::clamp(rig.influenceCount, 1, static_cast<int>(boneCount)));
+
+  aiMesh* mesh = new aiMesh();
+  mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+  mesh->mNumVertices = vertexCount;
+  mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+  mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+  mesh->mNumFaces = vertexCount - 2u;
+  mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+  // Alternate the order of every other triangle so that they all keep the same winding
+  for (unsigned int i = 0u; i < mesh->mNumFaces; ++i)
+  {
+    aiFace& face = mesh->mFaces[i];
+    face.mNumIndices = 3u;
+    face.mIndices = new unsigned int[3] { i % 2u == 0u ? i : i + 1u, i % 2u == 0u ? i + 1u : i, i + 2u };
+  }
+
+  std::mt19937 random(rig.seed);
+  std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f), weight(minSyntheticWeight, 1.0f);
+  std::vector<std::vector<aiVertexWeight>> boneWeights(boneCount); // Assimp stores the weights by bone
+  const unsigned int rigidVertexCount =
+    static_cast<unsigned int>(std::lround(std::clamp(rig.rigidShare, 0.0, 1.0) * vertexCount));
+  std::vector<unsigned int> influences;
+  std::vector<float> weights;
+  for (unsigned int i = 0u; i < vertexCount; ++i)
+  {
+    mesh->mVertices[i] = aiVector3D(coordinate(random), coordinate(random), coordinate(random));
+    mesh->mNormals[i] = aiVector3D(coordinate(random), coordinate(random), coordinate(random)).NormalizeSafe();
+
+    // The rigid vertices come first, so that their triangles form a rigid part of the mesh like a prop
+    const size_t vertexInfluenceCount = i < rigidVertexCount ? 1u : influenceCount;
+
+    // The bone of the vertex and its ancestors, then the bones after it once the root is reached
+    const unsigned int bone = static_cast<unsigned int>(static_cast<uint64_t>(i) * boneCount / vertexCount);
+    influences.clear();
+    for (int ancestor = static_cast<int>(bone); ancestor >= 0 && influences.size() < vertexInfluenceCount;
+         ancestor = parents.at(ancestor))
+    {
+      influences.push_back(static_cast<unsigned int>(ancestor));
+    }
+    for (unsigned int next = (bone + 1u) % boneCount; influences.size() < vertexInfluenceCount;
+         next = (next + 1u) % boneCount)
+    {
+      if (std::find(influences.begin(), influences.end(), next) == influences.end())
+      {
+        influences.push_back(next);
+      }
+    }
+
+    // The bone of the vertex has the largest weight
+    weights.resize(vertexInfluenceCount);
+    float totalWeight = 0.0f;
+    for (float& vertexWeight : weights)
+    {
+      vertexWeight = weight(random);
+      totalWeight += vertexWeight;
+    }
+    std::sort(weights.begin(), weights.end(), std::greater<float>());
+    for (size_t j = 0u; j < vertexInfluenceCount; ++j)
+    {
+      boneWeights.at(influences.at(j)).emplace_back(i, weights.at(j) / totalWeight);
+    }
+  }
+
+  mesh->mNumBones = boneCount;
+  mesh->mBones = new aiBone*[mesh->mNumBones];
+  for (unsigned int i = 0u; i < boneCount; ++i)
+  {
+    aiBone* bone = new aiBone();
+    bone->mName.Set("Bone" + std::to_string(i));
+    bone->mNumWeights = static_cast<unsigned int>(boneWeights.at(i).size());
+    bone->mWeights = new aiVertexWeight[std::max(bone->mNumWeights, 1u)];
+    std::copy(boneWeights.at(i).begin(), boneWeights.at(i).end(), bone->mWeights);
+    mesh->mBones[i] = bone;
+  }
+  return mesh;
+}
+
+// Builds a clip of the rig that moves each bone out of phase with the others and with the other clips
+aiAnimation* makeAnimation(const SyntheticRig& rig, unsigned int boneCount, unsigned int clip)
+{
+  aiAnimation* animation = new aiAnimation();
+  animation->mName.Set("Clip" + std::to_string(clip));
+  animation->mTicksPerSecond = syntheticTicksPerSecond;
+  animation->mDuration = syntheticTicksPerSecond * rig.clipDuration;
+  animation->mNumChannels = boneCount;
+  animation->mChannels = new aiNodeAnim*[animation->mNumChannels];
+
+  const unsigned int keyframeCount =
+    static_cast<unsigned int>(std::max(std::lround(rig.clipDuration * rig.keyframeRate), 0l)) + 1u;
+  for (unsigned int i = 0u; i < animation->mNumChannels; ++i)
+  {
+    aiNodeAnim* channel = new aiNodeAnim();
+    channel->mNodeName.Set("Bone" + std::to_string(i));
+    channel->mNumPositionKeys = channel->mNumRotationKeys = channel->mNumScalingKeys = keyframeCount;
+    channel->mPositionKeys = new aiVectorKey[keyframeCount];
+    channel->mRotationKeys = new aiQuatKey[keyframeCount];
+    channel->mScalingKeys = new aiVectorKey[keyframeCount];
+    for (unsigned int j = 0u; j < keyframeCount; ++j)
+    {
+      // A whole period over the clip, so that it loops seamlessly
+      const double time = animation->mDuration * j / std::max(keyframeCount - 1u, 1u);
+      const float phase = static_cast<float>(time / animation->mDuration) * glm::two_pi<float>();
+      const float angle = 0.5f * std::sin(phase + static_cast<float>(i + clip));
+      channel->mPositionKeys[j] = aiVectorKey(time, aiVector3D(0.0f, 0.1f, 0.01f * std::cos(phase)));
+      channel->mRotationKeys[j] = aiQuatKey(time, aiQuaternion(aiVector3D(1.0f, 0.0f, 0.0f), angle));
+      channel->mScalingKeys[j] = aiVectorKey(time, aiVector3D(1.0f));
+    }
+    animation->mChannels[i] = channel;
+  }
+  return animation;
+}
+
+} // namespace
+
+std::vector<int> makeSyntheticHierarchy(int boneCount, int depth, int branchingFactor)
+{
+  std::vector<int> parents(static_cast<size_t>(boneCount), -1);
+
+  // Grow the subtrees depth first, so that chains of bones are contiguous like in most exported skeletons
+  std::vector<std::pair<int, int>> pending; // Parent and level in the subtree of the bones still to add
+  for (int i = 1; i < boneCount; ++i)
+  {
+    if (pending.empty())
+    {
+      pending.emplace_back(0, 0);
+    }
+    const auto [parent, level] = pending.back();
+    pending.pop_back();
+
+    parents.at(i) = parent;
+    if (level + 1 < depth)
+    {
+      pending.insert(pending.end(), static_cast<size_t>(branchingFactor), { i, level + 1 });
+    }
+  }
+  return parents;
+}
+
+std::unique_ptr<aiScene> makeSyntheticScene(const SyntheticRig& rig)
+{
+  std::unique_ptr<aiScene> scene = std::make_unique<aiScene>();
+  const std::vector<int> parents =
+    makeSyntheticHierarchy(std::max(rig.boneCount, 1), std::max(rig.depth, 1), std::max(rig.branchingFactor, 1));
+
+  // Nodes, the root node is not a bone
+  makeNodes(parents, std::max(rig.helperCount, 0), *scene);
+
+  // Mesh
+  scene->mNumMeshes = 1u;
+  scene->mMeshes = new aiMesh*[1] { makeMesh(rig, parents) };
+
+  // Animations
+  scene->mNumAnimations = static_cast<unsigned int>(std::max(rig.clipCount, 1));
+  scene->mAnimations = new aiAnimation*[scene->mNumAnimations];
+  for (unsigned int clip = 0u; clip < scene->mNumAnimations; ++clip)
+  {
+    scene->mAnimations[clip] = makeAnimation(rig, static_cast<unsigned int>(parents.size()), clip);
+  }
+
+  return scene;
+}
+
+bool isSyntheticModelName(const char* name)
+{
+  return std::strncmp(name, syntheticModelPrefix, sizeof(syntheticModelPrefix) - 1u) == 0;
+}
+
+bool parseSyntheticModelName(const char* name, SyntheticRig& rig)
+{
+  std::string_view settings = std::string_view(name).substr(sizeof(syntheticModelPrefix) - 1u);
+  while (!settings.empty())
+  {
+    const size_t end = settings.find(',');
+    const std::string_view setting = settings.substr(0u, end);
+    settings = end != std::string_view::npos ? settings.substr(end + 1u) : std::string_view();
+
+    const size_t separator = setting.find('=');
+    if (separator == std::string_view::npos)
+    {
+      std::cerr << "Malformed synthetic model setting " << setting << " (expected name=value)\n";
+      return false;
+    }
+
+    const std::string_view key = setting.substr(0u, separator);
+    const double value = std::atof(std::string(setting.substr(separator + 1u)).c_str());
+    if (key == "bones")
+    {
+      rig.boneCount = std::max(static_cast<int>(value), 1);
+    }
+    else if (key == "depth")
+    {
+      rig.depth = std::max(static_cast<int>(value), 1);
+    }
+    else if (key == "branching")
+    {
+      rig.branchingFactor = std::max(static_cast<int>(value), 1);
+    }
+    else if (key == "helpers")
+    {
+      rig.helperCount = std::max(static_cast<int>(value), 0);
+    }
+    else if (key == "vertices")
+    {
+      rig.vertexCount = std::max(static_cast<int>(value), 3);
+    }
+    else if (key == "influences")
+    {
+      rig.influenceCount = std::max(static_cast<int>(value), 1);
+    }
+    else if (key == "rigid")
+    {
+      rig.rigidShare = std::clamp(value, 0.0, 1.0);
+    }
+    else if (key == "clips")
+    {
+      rig.clipCount = std::max(static_cast<int>(value), 1);
+    }
+    else if (key == "duration")
+    {
+      rig.clipDuration = std::max(value, 0.001);
+    }
+    else if (key == "rate")
+    {
+      rig.keyframeRate = std::max(value, 0.0);
+    }
+    else if (key == "seed")
+    {
+      rig.seed = static_cast<uint32_t>(value);
+    }
+    else
+    {
+      std::cerr << "Unknown synthetic model setting " << key << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace poser
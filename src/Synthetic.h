@@ -0,0 +1,49 @@
+#pragma once
+
+#include <assimp/scene.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace poser
+{
+
+// Prefix of the model names that select a synthetic model instead of a file, followed by comma separated settings of
+// the rig, for example "synthetic:bones=1024,depth=8,branching=2,vertices=100000,influences=4,rigid=0.8,rate=60"
+constexpr char syntheticModelPrefix[] = "synthetic:";
+
+// Synthetic rig definition, the shape of a generated skeleton with its skinned mesh and clips
+struct SyntheticRig
+{
+  int boneCount = 64;
+  int depth = 8;           // Of the subtrees hanging off the root bone, in bones
+  int branchingFactor = 1; // Children of each bone within a subtree, 1 for chains
+  int helperCount = 0;     // Nodes that are not bones, like those many tools export for attachments and IK targets
+  int vertexCount = 192;   // At least 3
+  int influenceCount = 1;  // Bones weighted to each vertex, at most the bone count
+  double rigidShare = 0.0; // Of the vertices weighted to their bone alone, like those of props and armour
+  int clipCount = 1;
+  double clipDuration = 1.0;  // In seconds
+  double keyframeRate = 30.0; // Keyframes per second of each track, spread evenly from the start to the end of the clip
+  uint32_t seed = 1u;         // Of the vertex positions, normals and bone weights
+};
+
+// Builds the parents of a synthetic skeleton with as many subtrees of the given depth and branching factor as the bone
+// count takes hanging off a single root bone, each bone comes after its parent
+std::vector<int> makeSyntheticHierarchy(int boneCount, int depth, int branchingFactor);
+
+// Builds a scene with a single mesh skinned to the bone hierarchy of the rig, helper nodes among the bones and clips
+// with a channel for each bone that move the bones out of phase with each other and loop seamlessly, the vertices are
+// spread over the bones in order, weighted to their bone alone for the rigid ones that come first, otherwise to their
+// bone, its ancestors and then the bones after it, and joined by a triangle strip
+std::unique_ptr<aiScene> makeSyntheticScene(const SyntheticRig& rig);
+
+// Returns true if the model name selects a synthetic model
+bool isSyntheticModelName(const char* name);
+
+// Parses the settings of a synthetic model name into the rig, keeping the defaults of settings the name leaves out,
+// returns false if a setting is malformed or unknown
+bool parseSyntheticModelName(const char* name, SyntheticRig& rig);
+
+} // namespace poser
@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace poser
+{
+
+ThreadPool::ThreadPool(unsigned int threadCount) : queues(std::max(threadCount, 1u))
+{
+  for (size_t i = 1u; i < queues.size(); ++i)
+  {
+    workers.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+
+  for (std::thread& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             size_t chunkSize,
+                             const std::function<void(size_t begin, size_t end)>& function)
+{
+  chunkSize = std::max(chunkSize, size_t(1u));
+  const size_t taskCount = (count + chunkSize - 1u) / chunkSize;
+  if (taskCount == 0u)
+  {
+    return;
+  }
+
+  this->function = &function;
+  unfinishedTaskCount = taskCount;
+
+  // Deal the tasks out to the queues round-robin
+  for (size_t i = 0u; i < taskCount; ++i)
+  {
+    Queue& queue = queues.at(i % queues.size());
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back({ i * chunkSize, std::min((i + 1u) * chunkSize, count) });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    queuedTaskCount += static_cast<ptrdiff_t>(taskCount);
+  }
+  wakeCondition.notify_all();
+
+  // Help out until no task is left to take, then wait for the workers to finish theirs
+  while (runTask(0u))
+  {
+  }
+
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  finishedCondition.wait(lock, [this] { return unfinishedTaskCount == 0u; });
+  this->function = nullptr;
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+  return static_cast<unsigned int>(queues.size());
+}
+
+// Runs the newest task of the queue or, if that is empty, steals the oldest task of another queue, returns false if
+// there was no task to run
+bool ThreadPool::runTask(size_t queueIndex)
+{
+  Task task;
+  bool found = false;
+  for (size_t i = 0u; i < queues.size() && !found; ++i)
+  {
+    Queue& queue = queues.at((queueIndex + i) % queues.size());
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty())
+    {
+      if (i == 0u)
+      {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+      }
+      else
+      {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+      }
+      found = true;
+    }
+  }
+
+  if (!found)
+  {
+    return false;
+  }
+
+  --queuedTaskCount;
+  (*function)(task.begin, task.end);
+
+  if (--unfinishedTaskCount == 0u)
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex); // Prevents the notification from slipping past the waiting thread
+    finishedCondition.notify_all();
+  }
+
+  return true;
+}
+
+void ThreadPool::work(size_t queueIndex)
+{
+  while (true)
+  {
+    if (runTask(queueIndex))
+    {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCondition.wait(lock, [this] { return stopping || queuedTaskCount > 0; });
+    if (stopping)
+    {
+      return;
+    }
+  }
+}
+
+} // namespace poser
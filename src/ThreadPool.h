@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace poser
+{
+
+// Thread pool definition, each thread owns a queue of tasks and steals tasks from the other queues once its own queue
+// runs dry, the thread calling parallelFor() works on the tasks as well
+class ThreadPool
+{
+public:
+  explicit ThreadPool(unsigned int threadCount); // Including the calling thread
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Calls the function for consecutive ranges of at most chunk size indices covering [0, count) and waits for all calls
+  // to return, must not be called from within the function
+  void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& function);
+
+  unsigned int getThreadCount() const;
+
+private:
+  struct Task
+  {
+    size_t begin, end;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool runTask(size_t queueIndex);
+  void work(size_t queueIndex);
+
+  std::vector<std::thread> workers;
+  std::vector<Queue> queues; // One per thread, the calling thread uses the first one
+
+  const std::function<void(size_t, size_t)>* function = nullptr;
+  std::atomic<size_t> unfinishedTaskCount = 0u;
+
+  std::mutex wakeMutex;
+  std::condition_variable wakeCondition, finishedCondition;
+  std::atomic<ptrdiff_t> queuedTaskCount = 0; // May briefly go negative when a task is taken before it was counted
+  bool stopping = false;
+};
+
+} // namespace poser
@@ -0,0 +1,458 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace poser
+{
+
+namespace
+{
+
+// Packing constants
+constexpr float normalScale = 32767.0f; // Largest signed normalized 16-bit value
+
+// Returns the number of bones affecting the vertex, at least 1 so that vertices without bones go through the same
+// skinning, missing bones come last so this is the index of the first one
+int getVertexInfluenceCount(const Vertex& vertex)
+{
+  int influenceCount = 1;
+  while (influenceCount < maxInfluenceCount && vertex.boneIds[influenceCount] >= 0)
+  {
+    ++influenceCount;
+  }
+  return influenceCount;
+}
+
+// Returns true if the weight quantizes to zero in the component, the bone would then be missing once packed
+template<typename Component>
+bool quantizesToZero(float weight)
+{
+  return std::lround(std::clamp(weight, 0.0f, 1.0f) * std::numeric_limits<Component>::max()) == 0;
+}
+
+template<typename Component>
+void dropZeroWeightInfluences(Vertex& vertex)
+{
+  int keptCount = 0;
+  float weightSum = 0.0f;
+  for (int influence = 0; influence < maxInfluenceCount; ++influence)
+  {
+    if (vertex.boneIds[influence] >= 0 && !quantizesToZero<Component>(vertex.boneWeights[influence]))
+    {
+      vertex.boneIds[keptCount] = vertex.boneIds[influence];
+      vertex.boneWeights[keptCount] = vertex.boneWeights[influence];
+      weightSum += vertex.boneWeights[influence];
+      ++keptCount;
+    }
+  }
+
+  for (int influence = 0; influence < maxInfluenceCount; ++influence)
+  {
+    if (influence < keptCount)
+    {
+      vertex.boneWeights[influence] /= weightSum;
+    }
+    else
+    {
+      vertex.boneIds[influence] = -1;
+      vertex.boneWeights[influence] = 0.0f;
+    }
+  }
+}
+
+template<typename Component>
+PackedVertex<Component> packVertex(const Vertex& vertex)
+{
+  constexpr int maxWeight = std::numeric_limits<Component>::max();
+
+  PackedVertex<Component> packedVertex;
+  packedVertex.position = vertex.position;
+
+  const glm::vec2 encodedNormal = glm::round(encodeOctahedral(vertex.normal) * normalScale);
+  packedVertex.normal[0] = static_cast<int16_t>(encodedNormal.x);
+  packedVertex.normal[1] = static_cast<int16_t>(encodedNormal.y);
+
+  // Quantize the weights and give the rounding error to the largest one so that they keep their sum
+  float weightSum = 0.0f;
+  int quantizedWeightSum = 0, largestInfluence = -1;
+  for (int influence = 0; influence < maxInfluenceCount; ++influence)
+  {
+    const int boneId = vertex.boneIds[influence];
+    const float weight = boneId >= 0 ? vertex.boneWeights[influence] : 0.0f;
+    assert(boneId <= maxWeight);
+
+    const int quantizedWeight = static_cast<int>(std::lround(std::clamp(weight, 0.0f, 1.0f) * maxWeight));
+    packedVertex.boneIds[influence] = static_cast<Component>(quantizedWeight > 0 ? boneId : 0);
+    packedVertex.boneWeights[influence] = static_cast<Component>(quantizedWeight);
+
+    weightSum += weight;
+    quantizedWeightSum += quantizedWeight;
+    if (quantizedWeight > 0 &&
+        (largestInfluence < 0 || quantizedWeight > packedVertex.boneWeights[largestInfluence]))
+    {
+      largestInfluence = influence;
+    }
+  }
+
+  if (largestInfluence >= 0)
+  {
+    const int targetSum = static_cast<int>(std::lround(std::clamp(weightSum, 0.0f, 1.0f) * maxWeight));
+    const int weight = packedVertex.boneWeights[largestInfluence] + targetSum - quantizedWeightSum;
+    packedVertex.boneWeights[largestInfluence] = static_cast<Component>(std::clamp(weight, 0, maxWeight));
+  }
+
+  return packedVertex;
+}
+
+template<typename Component>
+Vertex unpackVertex(const PackedVertex<Component>& packedVertex)
+{
+  constexpr float maxWeight = static_cast<float>(std::numeric_limits<Component>::max());
+
+  Vertex vertex;
+  vertex.position = packedVertex.position;
+  vertex.normal = glm::normalize(
+    decodeOctahedral(glm::vec2(packedVertex.normal[0], packedVertex.normal[1]) / normalScale));
+  for (int influence = 0; influence < maxInfluenceCount; ++influence)
+  {
+    const bool present = packedVertex.boneWeights[influence] > 0u;
+    vertex.boneIds[influence] = present ? static_cast<int>(packedVertex.boneIds[influence]) : -1;
+    vertex.boneWeights[influence] = static_cast<float>(packedVertex.boneWeights[influence]) / maxWeight;
+  }
+  return vertex;
+}
+
+} // namespace
+
+VertexFormat chooseVertexFormat(size_t boneCount)
+{
+  assert(boneCount <= size_t(std::numeric_limits<uint16_t>::max()) + 1u);
+  return boneCount <= size_t(std::numeric_limits<uint8_t>::max()) + 1u ? VertexFormat::Packed8
+                                                                        : VertexFormat::Packed16;
+}
+
+const char* getVertexFormatName(VertexFormat vertexFormat)
+{
+  switch (vertexFormat)
+  {
+  case VertexFormat::Packed8:
+    return "Packed 8-bit";
+  case VertexFormat::Packed16:
+    return "Packed 16-bit";
+  }
+  return "Unknown";
+}
+
+size_t getPackedVertexSize(VertexFormat vertexFormat)
+{
+  return vertexFormat == VertexFormat::Packed8 ? sizeof(PackedVertex8) : sizeof(PackedVertex16);
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& vector)
+{
+  const float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+  if (length <= 0.0f)
+  {
+    return glm::vec2(0.0f);
+  }
+
+  // Project onto the octahedron and fold the lower half over the upper half
+  const glm::vec3 projected = vector / length;
+  if (projected.z >= 0.0f)
+  {
+    return glm::vec2(projected);
+  }
+
+  return glm::vec2((1.0f - std::abs(projected.y)) * (projected.x >= 0.0f ? 1.0f : -1.0f),
+                   (1.0f - std::abs(projected.x)) * (projected.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+{
+  glm::vec3 vector(encoded, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  const float fold = std::max(-vector.z, 0.0f);
+  vector.x += vector.x >= 0.0f ? -fold : fold;
+  vector.y += vector.y >= 0.0f ? -fold : fold;
+  return vector;
+}
+
+int getInfluenceCount(const std::vector<Vertex>& vertices)
+{
+  int influenceCount = 1;
+  for (const Vertex& vertex : vertices)
+  {
+    influenceCount = std::max(influenceCount, getVertexInfluenceCount(vertex));
+  }
+  return influenceCount;
+}
+
+std::vector<InfluenceRange> getInfluenceRanges(const std::vector<Vertex>& vertices)
+{
+  std::vector<InfluenceRange> influenceRanges;
+  for (size_t i = 0u; i < vertices.size(); ++i)
+  {
+    const int influenceCount = getVertexInfluenceCount(vertices[i]);
+    if (!influenceRanges.empty() && influenceRanges.back().influenceCount == influenceCount)
+    {
+      ++influenceRanges.back().vertexCount;
+    }
+    else
+    {
+      influenceRanges.push_back({ static_cast<uint32_t>(i), 1u, influenceCount });
+    }
+  }
+  return influenceRanges;
+}
+
+void dropZeroWeightInfluences(VertexFormat vertexFormat, std::vector<Vertex>& vertices)
+{
+  if (vertexFormat == VertexFormat::Packed8)
+  {
+    std::for_each(vertices.begin(), vertices.end(), dropZeroWeightInfluences<uint8_t>);
+  }
+  else
+  {
+    std::for_each(vertices.begin(), vertices.end(), dropZeroWeightInfluences<uint16_t>);
+  }
+}
+
+void packVertices(size_t boneCount, Mesh& mesh)
+{
+  mesh.vertexFormat = chooseVertexFormat(boneCount);
+  mesh.packedVertices8.clear();
+  mesh.packedVertices16.clear();
+  if (mesh.vertexFormat == VertexFormat::Packed8)
+  {
+    packVertices(mesh.vertices, mesh.packedVertices8);
+  }
+  else
+  {
+    packVertices(mesh.vertices, mesh.packedVertices16);
+  }
+}
+
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex8>& packedVertices)
+{
+  packedVertices.resize(vertices.size());
+  std::transform(vertices.begin(), vertices.end(), packedVertices.begin(), packVertex<uint8_t>);
+}
+
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex16>& packedVertices)
+{
+  packedVertices.resize(vertices.size());
+  std::transform(vertices.begin(), vertices.end(), packedVertices.begin(), packVertex<uint16_t>);
+}
+
+IndexFormat chooseIndexFormat(size_t vertexCount)
+{
+  return vertexCount <= size_t(std::numeric_limits<uint16_t>::max()) + 1u ? IndexFormat::Index16
+                                                                          : IndexFormat::Index32;
+}
+
+const char* getIndexFormatName(IndexFormat indexFormat)
+{
+  switch (indexFormat)
+  {
+  case IndexFormat::Index16:
+    return "16-bit";
+  case IndexFormat::Index32:
+    return "32-bit";
+  }
+  return "Unknown";
+}
+
+size_t getIndexSize(IndexFormat indexFormat)
+{
+  return indexFormat == IndexFormat::Index16 ? sizeof(uint16_t) : sizeof(unsigned int);
+}
+
+void batchSubmeshes(Mesh& mesh)
+{
+  constexpr size_t maxIndex16VertexCount = size_t(std::numeric_limits<uint16_t>::max()) + 1u;
+  std::vector<Submesh>& submeshes = mesh.submeshes;
+
+  // Each submesh still starts at its own base vertex and ends where the next one starts
+  std::vector<size_t> vertexCounts(submeshes.size());
+  for (size_t i = 0u; i < submeshes.size(); ++i)
+  {
+    const size_t vertexEnd = i + 1u < submeshes.size() ? submeshes.at(i + 1u).baseVertex : mesh.vertices.size();
+    vertexCounts.at(i) = vertexEnd - submeshes.at(i).baseVertex;
+  }
+
+  // 32-bit indices address every vertex, so a single submesh too large for 16-bit indices puts all into one batch
+  const bool index16 = std::all_of(vertexCounts.begin(), vertexCounts.end(),
+                                   [](size_t vertexCount) { return vertexCount <= maxIndex16VertexCount; });
+
+  uint32_t batchBaseVertex = 0u;
+  size_t batchVertexCount = 0u;
+  for (size_t i = 0u; i < submeshes.size(); ++i)
+  {
+    Submesh& submesh = submeshes.at(i);
+    if (index16 && batchVertexCount + vertexCounts.at(i) > maxIndex16VertexCount)
+    {
+      batchBaseVertex = submesh.baseVertex;
+      batchVertexCount = 0u;
+    }
+
+    // Rebase the indices onto the first vertex of the batch
+    const uint32_t offset = submesh.baseVertex - batchBaseVertex;
+    for (uint32_t j = submesh.firstIndex; j < submesh.firstIndex + submesh.indexCount; ++j)
+    {
+      mesh.indices.at(j) += offset;
+    }
+    submesh.baseVertex = batchBaseVertex;
+    batchVertexCount += vertexCounts.at(i);
+  }
+}
+
+void sortVerticesByInfluenceCount(std::vector<unsigned int>& indices, std::vector<Vertex>& vertices)
+{
+  std::vector<int> influenceCounts(vertices.size());
+  std::transform(vertices.begin(), vertices.end(), influenceCounts.begin(), getVertexInfluenceCount);
+  std::vector<unsigned int> order(vertices.size()), remap(vertices.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](unsigned int a, unsigned int b) { return influenceCounts[a] < influenceCounts[b]; });
+
+  std::vector<Vertex> sortedVertices(vertices.size());
+  for (size_t i = 0u; i < order.size(); ++i)
+  {
+    remap[order[i]] = static_cast<unsigned int>(i);
+    sortedVertices[i] = vertices[order[i]];
+  }
+  for (unsigned int& index : indices)
+  {
+    index = remap.at(index);
+  }
+  vertices.swap(sortedVertices);
+}
+
+void splitSubmeshesByInfluenceCount(Mesh& mesh)
+{
+  std::vector<Submesh> splitSubmeshes;
+  std::vector<unsigned int> indices;
+  splitSubmeshes.reserve(mesh.submeshes.size());
+  indices.reserve(mesh.indices.size());
+
+  // Each batch keeps its vertices, which end where the next batch starts
+  for (size_t batchBegin = 0u, batchEnd = 0u; batchBegin < mesh.submeshes.size(); batchBegin = batchEnd)
+  {
+    const uint32_t baseVertex = mesh.submeshes.at(batchBegin).baseVertex;
+    while (batchEnd < mesh.submeshes.size() && mesh.submeshes.at(batchEnd).baseVertex == baseVertex)
+    {
+      ++batchEnd;
+    }
+    const size_t vertexEnd =
+      batchEnd < mesh.submeshes.size() ? mesh.submeshes.at(batchEnd).baseVertex : mesh.vertices.size();
+
+    // Order the vertices of the batch by influence count, the indices of its submeshes follow each other
+    std::vector<Vertex> batchVertices(mesh.vertices.begin() + baseVertex, mesh.vertices.begin() + vertexEnd);
+    const uint32_t batchFirstIndex = mesh.submeshes.at(batchBegin).firstIndex;
+    std::vector<unsigned int> batchIndices(mesh.indices.begin() + batchFirstIndex,
+                                           mesh.indices.begin() + mesh.submeshes.at(batchEnd - 1u).firstIndex +
+                                             mesh.submeshes.at(batchEnd - 1u).indexCount);
+    sortVerticesByInfluenceCount(batchIndices, batchVertices);
+    std::copy(batchVertices.begin(), batchVertices.end(), mesh.vertices.begin() + baseVertex);
+    std::vector<int> influenceCounts(batchVertices.size());
+    std::transform(batchVertices.begin(), batchVertices.end(), influenceCounts.begin(), getVertexInfluenceCount);
+
+    // Gather the triangles of the submeshes of the batch with each influence count in turn, so that the submeshes with
+    // the same count follow each other and share a draw range
+    for (int influenceCount = 1; influenceCount <= maxInfluenceCount; ++influenceCount)
+    {
+      for (size_t i = batchBegin; i < batchEnd; ++i)
+      {
+        const Submesh& submesh = mesh.submeshes.at(i);
+        const uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+        for (uint32_t j = submesh.firstIndex - batchFirstIndex;
+             j < submesh.firstIndex - batchFirstIndex + submesh.indexCount; j += 3u)
+        {
+          const unsigned int* triangle = &batchIndices.at(j);
+          if (std::max({ influenceCounts[triangle[0]], influenceCounts[triangle[1]], influenceCounts[triangle[2]] }) ==
+              influenceCount)
+          {
+            indices.insert(indices.end(), triangle, triangle + 3);
+          }
+        }
+
+        const uint32_t indexCount = static_cast<uint32_t>(indices.size()) - firstIndex;
+        if (indexCount > 0u)
+        {
+          splitSubmeshes.push_back({ firstIndex, indexCount, baseVertex, static_cast<uint32_t>(influenceCount) });
+        }
+      }
+    }
+  }
+
+  mesh.submeshes = std::move(splitSubmeshes);
+  mesh.indices = std::move(indices);
+}
+
+std::vector<DrawRange> getDrawRanges(const Mesh& mesh)
+{
+  std::vector<DrawRange> drawRanges;
+  for (const Submesh& submesh : mesh.submeshes)
+  {
+    if (!drawRanges.empty() && drawRanges.back().baseVertex == submesh.baseVertex &&
+        drawRanges.back().influenceCount == submesh.influenceCount)
+    {
+      drawRanges.back().indexCount += submesh.indexCount;
+    }
+    else
+    {
+      drawRanges.push_back(
+        { submesh.firstIndex, submesh.indexCount, submesh.baseVertex, 0u, submesh.influenceCount });
+    }
+  }
+
+  // Each draw range uses the vertices of its batch, up to the base vertex of the next batch
+  size_t vertexEnd = mesh.vertices.size();
+  for (size_t i = drawRanges.size(); i > 0u; --i)
+  {
+    DrawRange& drawRange = drawRanges.at(i - 1u);
+    if (i < drawRanges.size() && drawRanges.at(i).baseVertex != drawRange.baseVertex)
+    {
+      vertexEnd = drawRanges.at(i).baseVertex;
+    }
+    drawRange.vertexCount = static_cast<uint32_t>(vertexEnd - drawRange.baseVertex);
+  }
+  return drawRanges;
+}
+
+size_t getMaxDrawRangeVertexCount(const Mesh& mesh)
+{
+  size_t maxVertexCount = 0u;
+  for (const DrawRange& drawRange : getDrawRanges(mesh))
+  {
+    maxVertexCount = std::max(maxVertexCount, size_t(drawRange.vertexCount));
+  }
+  return maxVertexCount;
+}
+
+void packIndices(Mesh& mesh)
+{
+  mesh.indexFormat = chooseIndexFormat(getMaxDrawRangeVertexCount(mesh));
+  mesh.packedIndices16.clear();
+  if (mesh.indexFormat == IndexFormat::Index16)
+  {
+    mesh.packedIndices16.assign(mesh.indices.begin(), mesh.indices.end());
+  }
+}
+
+void unpackVertices(const std::vector<PackedVertex8>& packedVertices, std::vector<Vertex>& vertices)
+{
+  vertices.resize(packedVertices.size());
+  std::transform(packedVertices.begin(), packedVertices.end(), vertices.begin(), unpackVertex<uint8_t>);
+}
+
+void unpackVertices(const std::vector<PackedVertex16>& packedVertices, std::vector<Vertex>& vertices)
+{
+  vertices.resize(packedVertices.size());
+  std::transform(packedVertices.begin(), packedVertices.end(), vertices.begin(), unpackVertex<uint16_t>);
+}
+
+} // namespace poser
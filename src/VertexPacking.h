@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace poser
+{
+
+// Returns the smallest vertex format whose bone ids fit the bone count
+VertexFormat chooseVertexFormat(size_t boneCount);
+
+const char* getVertexFormatName(VertexFormat vertexFormat);
+
+// Returns the size in bytes of a vertex packed in the vertex format
+size_t getPackedVertexSize(VertexFormat vertexFormat);
+
+// Maps the unit vector onto the octahedron and unfolds it into [-1, 1] x [-1, 1]
+glm::vec2 encodeOctahedral(const glm::vec3& vector);
+
+// Folds the octahedral encoding back into a vector, which is not normalized
+glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+// Returns the largest number of bones affecting any of the vertices, at least 1
+int getInfluenceCount(const std::vector<Vertex>& vertices);
+
+// Returns the runs of consecutive vertices affected by the same number of bones, at least 1, which cover all vertices
+std::vector<InfluenceRange> getInfluenceRanges(const std::vector<Vertex>& vertices);
+
+// Drops the influences whose weight quantizes to zero in the vertex format and renormalizes the remaining ones, so that
+// the vertices are affected by the same bones before packing and after unpacking, must run before the influence counts
+// of the vertices are used
+void dropZeroWeightInfluences(VertexFormat vertexFormat, std::vector<Vertex>& vertices);
+
+// Packs the vertices of the mesh in the vertex format chosen for the bone count
+void packVertices(size_t boneCount, Mesh& mesh);
+
+// Packs the vertices in the format of the packed vertices, the bone ids must fit
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex8>& packedVertices);
+void packVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex16>& packedVertices);
+
+// Returns the smallest index format that can address the vertex count, which for a mesh is that of its largest draw
+// range since the indices are relative to the base vertex
+IndexFormat chooseIndexFormat(size_t vertexCount);
+
+const char* getIndexFormatName(IndexFormat indexFormat);
+
+// Returns the size in bytes of an index in the index format
+size_t getIndexSize(IndexFormat indexFormat);
+
+// Merges consecutive submeshes, which each start at their own base vertex, into as few batches sharing a base vertex
+// as the range of 16-bit indices allows, or into a single one if some submesh needs 32-bit indices anyway, and rebases
+// their indices accordingly
+void batchSubmeshes(Mesh& mesh);
+
+// Orders the vertices by the number of bones affecting them and remaps the indices, keeps the order of the vertices
+// affected by the same number of bones
+void sortVerticesByInfluenceCount(std::vector<unsigned int>& indices, std::vector<Vertex>& vertices);
+
+// Orders the vertices of each batch by the number of bones affecting them and splits each submesh into one per number
+// of bones affecting the vertices of its triangles at most, ordered by that number within the batch, so that the
+// vertices and the draw ranges each get skinned with code specialized for their number of bones, keeps the order of the
+// vertices and the triangles otherwise, must run after batching the submeshes and before optimizing the mesh
+void splitSubmeshesByInfluenceCount(Mesh& mesh);
+
+// Returns the draw ranges of the batched submeshes of the mesh, one per draw call
+std::vector<DrawRange> getDrawRanges(const Mesh& mesh);
+
+// Returns the vertex count of the largest draw range of the mesh
+size_t getMaxDrawRangeVertexCount(const Mesh& mesh);
+
+// Packs the indices of the mesh in the index format chosen for its largest draw range
+void packIndices(Mesh& mesh);
+
+// Unpacks the vertices, missing bones get an id of -1
+void unpackVertices(const std::vector<PackedVertex8>& packedVertices, std::vector<Vertex>& vertices);
+void unpackVertices(const std::vector<PackedVertex16>& packedVertices, std::vector<Vertex>& vertices);
+
+} // namespace poser